@@ -1,8 +1,12 @@
 #include "alias_module.h"
 
+/* static function prototypes */
+static int         match_alias( const void* entry, const char* name, size_t length );
+
 /* globals */
-int     n_aliases = 0;
-alias   aliases[ALIAS_LIMIT];
+static alias_table  table = { { NULL, NULL, 0, 0, ALIAS_START_SIZE, "alias", match_alias }, NULL, 0, NULL };
+static word_vector  value_words = { NULL, NULL, 0, 0 };
+unsigned long alias_generation = 0;
 
 /*********************************************************************/
 /*                                                                   */
@@ -12,45 +16,89 @@ alias   aliases[ALIAS_LIMIT];
 /*          char* name:  alias name                                  */
 /*          char* value: alias value                                 */
 /*                                                                   */
+/*      Description:                                                 */
+/*          splits value into words, then copies name, value and     */
+/*          the words into a single block and stores it in the       */
+/*          table. Expanding the alias later only splices in the     */
+/*          words, nothing is parsed again.                          */
+/*                                                                   */
 /*********************************************************************/
 int add_alias( char* name, char* value )
 {
-    // check that we haven't reached max amount of aliases
-    if ( n_aliases == ALIAS_LIMIT )
+    alias* a;
+    void* old;
+    size_t name_len, value_len, size, word_len;
+    uint64_t hash = hash_string( name, &name_len );
+    char* text;
+    int i;
+
+    if ( name_len == 0 )
     {
-        fprintf( stderr, "Error: Maximum number of allowed aliases reached.\n" );
+        fprintf( stderr, "Error: alias name is empty.\n" );
         return FAILURE;
     }
 
-    // check if alias already exists 
-    if ( find_alias( name ) != NULL )
+    // check if alias already exists
+    if ( table_get( &table.aliases, name, name_len, hash ) != NULL )
     {
         fprintf( stderr, "Error: Alias already exists.\n" );
         return FAILURE;
     }
 
-    // check that alias name & value is within limit
-    if ( strlen( name ) >= NAME_LIMIT )
+    // split the value into words, they are copied below
+    value_words.count = 0;
+    if ( parse_string( value, &value_words ) == FAILURE )
     {
-        fprintf( stderr, "Error: alias name is too large." );
+        fprintf( stderr, "Error: could not parse alias value\n" );
         return FAILURE;
     }
-    else if ( strlen( value ) >= VALUE_LIMIT )
+
+    // pointers first, then kinds, then characters so everything is aligned
+    value_len = strlen( value );
+    size = sizeof(alias) + ( value_words.count + 1 ) * sizeof(char*) +
+           value_words.count * sizeof(token_kind) + name_len + value_len + 2;
+
+    for ( i = 0; i < value_words.count; i++ )
+        size += strlen( value_words.words[i] ) + 1;
+
+    if ( ( a = (alias*)malloc( size ) ) == NULL )
     {
-        fprintf( stderr, "Error: alias value is too large." );
+        fprintf( stderr, "Error: could not allocate memory for alias %s\n", name );
         return FAILURE;
     }
 
-    // copy alias name into structure
-    strcpy( aliases[n_aliases].name, name );
+    a->retired = NULL;
+    a->n_words = value_words.count;
+    a->words = (char**)( a + 1 );
+    a->kinds = (token_kind*)( a->words + value_words.count + 1 );
+    memcpy( a->kinds, value_words.kinds, value_words.count * sizeof(token_kind) );
+
+    // copy alias name & value after the arrays, then the words
+    a->name = (char*)( a->kinds + value_words.count );
+    memcpy( a->name, name, name_len + 1 );
+    a->value = a->name + name_len + 1;
+    memcpy( a->value, value, value_len + 1 );
 
-    // copy alias value into structure
-    strcpy( aliases[n_aliases].value, value );
+    text = a->value + value_len + 1;
+    for ( i = 0; i < value_words.count; i++ )
+    {
+        word_len = strlen( value_words.words[i] ) + 1;
+        memcpy( text, value_words.words[i], word_len );
+        a->words[i] = text;
+        text += word_len;
+    }
+    a->words[i] = NULL;
+
+    if ( table_put( &table.aliases, a, a->name, name_len, hash, &old ) == FAILURE )
+    {
+        free( a );
+        return FAILURE;
+    }
 
-    // sort array for bsearch() & increment n_aliases
-    qsort( aliases, (size_t)(++n_aliases), sizeof(aliases[0]), alias_cmp );
+    // anything expanded with the old aliases is out of date
+    alias_generation++;
 
-    return SUCCESS; 
+    return SUCCESS;
 } /* end add_alias() */
 
 
@@ -61,24 +109,30 @@ int add_alias( char* name, char* value )
 /*      Parameter(s):                                                */
 /*          const char* a: alias name to remove                      */
 /*                                                                   */
+/*      Description:                                                 */
+/*          takes the alias out of the table. It is only freed by    */
+/*          release_aliases(), since the current line may still use  */
+/*          its words.                                               */
+/*                                                                   */
 /*********************************************************************/
 int remove_alias( const char* a )
 {
-    // search for alias
-    alias* found = find_alias( a );
+    size_t length;
+    uint64_t hash = hash_string( a, &length );
+    alias* removed;
 
     // check that alias exists
-    if ( found == NULL )
+    if ( ( removed = (alias*)table_remove( &table.aliases, a, length, hash ) ) == NULL )
     {
         fprintf( stderr, "Error. Alias does not exist.\n" );
         return FAILURE;
     }
 
-    // remove this alias
-    adjust_aliases( found );
-    
-    // sort array for bsearch() & decrement n_aliases
-    qsort( aliases, (size_t)(--n_aliases), sizeof(aliases[0]), alias_cmp );
+    removed->retired = table.retired;
+    table.retired = removed;
+
+    // anything expanded with the old aliases is out of date
+    alias_generation++;
 
     return SUCCESS;
 } /* end remove_alias() */
@@ -95,67 +149,112 @@ int remove_alias( const char* a )
 /*********************************************************************/
 alias* find_alias( const char* a )
 {
+    size_t length;
+    uint64_t hash;
 
-    alias* found = NULL;
-    found = (alias*)bsearch( a, aliases, (size_t)n_aliases, 
-                             sizeof( aliases[0] ), alias_cmp );
+    if ( table.aliases.count == 0 )
+        return NULL;
 
-    return found;
+    hash = hash_string( a, &length );
+    return (alias*)table_get( &table.aliases, a, length, hash );
 } /* end find_alias() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: adjust_aliases                                */
-/*      Return type:   none                                          */
+/*      Function name: print_aliases                                 */
+/*      Return type:   void                                          */
 /*      Parameter(s):                                                */
-/*          alias* found: pointer to the type alias struct we are    */
-/*                        removing. i.e. the start point             */
+/*          FILE* out: where to print                                */
 /*                                                                   */
 /*      Description:                                                 */
-/*          Adjusts the array of aliases when removing an alias by   */
-/*          moving all later alias instances down an index.          */
+/*          prints every alias sorted by name. The sorted view is    */
+/*          only rebuilt when the aliases changed since the last     */
+/*          time they were printed.                                  */
 /*                                                                   */
 /*********************************************************************/
-void adjust_aliases( alias* found )
+void print_aliases( FILE* out )
 {
-    // move all values down one index in the array
-    for ( ; found != &aliases[n_aliases-1]; found++ )
+    alias** sorted;
+    size_t i, n = 0;
+
+    if ( table.aliases.count == 0 )
     {
-        // copy next struct to this one (shifting them down)
-        strcpy( found->name, ( found + 1 )->name );
-        strcpy( found->value, ( found + 1 )->value );
+        fputs( "No aliases have been created.\n", out );
+        return;
     }
-    
-    // clear last alias values
-    memset( found->name, 0, NAME_LIMIT );
-    memset( found->value, 0, VALUE_LIMIT );
+
+    if ( table.sorted_generation != alias_generation )
+    {
+        if ( ( sorted = (alias**)realloc( table.sorted, table.aliases.count * sizeof(alias*) ) ) == NULL )
+        {
+            fprintf( stderr, "Error: could not allocate memory to sort aliases\n" );
+            return;
+        }
+        table.sorted = sorted;
+
+        for ( i = 0; i < table.aliases.capacity; i++ )
+        {
+            if ( table.aliases.slots[i] != NULL )
+                table.sorted[n++] = (alias*)table.aliases.slots[i];
+        }
+
+        qsort( table.sorted, table.aliases.count, sizeof(alias*), alias_cmp );
+        table.sorted_generation = alias_generation;
+    }
+
+    for( i = 0; i < table.aliases.count; i++ )
+        fprintf( out, "%s\t%s\n", table.sorted[i]->name, table.sorted[i]->value );
 
     return;
-} /* end adjust_aliases */
+} /* end print_aliases */
+
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: print_aliases                                 */
+/*      Function name: release_aliases                               */
 /*      Return type:   void                                          */
 /*      Parameter(s):  none                                          */
 /*                                                                   */
+/*      Description:                                                 */
+/*          frees the aliases removed while the last line ran. Call  */
+/*          once nothing points at their words any more.             */
+/*                                                                   */
 /*********************************************************************/
-void print_aliases( void )
+void release_aliases( void )
 {
-    if ( n_aliases == 0 )
+    alias* a;
+
+    while ( ( a = table.retired ) != NULL )
     {
-        puts( "No aliases have been created." );
-        return;
+        table.retired = a->retired;
+        free( a );
     }
 
-    int ctr;
+    return;
+} /* end release_aliases() */
 
-    for( ctr = 0; ctr < n_aliases; ctr++ )
-        printf( "%s\t%s\n", aliases[ctr].name, aliases[ctr].value );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: free_aliases                                  */
+/*      Return type:   void                                          */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*********************************************************************/
+void free_aliases( void )
+{
+    release_aliases();
+    table_free( &table.aliases );
+
+    free( table.sorted );
+    table.sorted = NULL;
+    table.sorted_generation = 0;
+    free_strings( &value_words );
+    alias_generation++;
 
     return;
-} /* end print_aliases */
+} /* end free_aliases() */
 
 
 /*********************************************************************/
@@ -163,13 +262,38 @@ void print_aliases( void )
 /*      Function name: alias_cmp                                     */
 /*      Return type:   int                                           */
 /*      Parameter(s):                                                */
-/*          a1: pointer to first alias.                              */
-/*          a2: pointer to second alias.                             */
+/*          a1: pointer to first alias pointer.                      */
+/*          a2: pointer to second alias pointer.                     */
 /*      Description:                                                 */
-/*          used to compare aliases for qsort and bsearch.           */
+/*          used to compare aliases for qsort.                       */
 /*                                                                   */
 /*********************************************************************/
 int alias_cmp( const void* a1, const void* a2 )
 {
-    return strcmp( ((const alias*)a1)->name, ((const alias*)a2)->name );
+    return strcmp( (*(alias* const*)a1)->name, (*(alias* const*)a2)->name );
 } /* end alias_cmp() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: match_alias                                   */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          const void* entry: alias in the table                    */
+/*          const char* name: name to find                           */
+/*          size_t length: length of name                            */
+/*                                                                   */
+/*********************************************************************/
+static int match_alias( const void* entry, const char* name, size_t length )
+{
+    const alias* a = (const alias*)entry;
+
+    return ( strncmp( a->name, name, length ) == 0 && a->name[length] == '\0' );
+} /* end match_alias() */
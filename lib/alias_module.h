@@ -3,37 +3,57 @@
 /*          Module name: alias_module.h                              */
 /*          Description:                                             */
 /*              This module provides structures and functions to     */
-/*              store and remove aliases.                            */
+/*              store and remove aliases. Aliases live in an open    */
+/*              addressing hash table that doubles when it gets half */
+/*              full, so there is no limit on how many there are.    */
 /*                                                                   */
 /*********************************************************************/
 
 
-#ifndef ALIAS_MODULE_H 
+#ifndef ALIAS_MODULE_H
 #define ALIAS_MODULE_H
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
 #include "string_module.h"
+#include "table_module.h"
 
-#define ALIAS_LIMIT 250 
-#define VALUE_LIMIT 150
-#define NAME_LIMIT 50
+#define ALIAS_START_SIZE 64     /* slots, must be a power of 2 */
 
-/* structure to hold alias values */
+/* structure to hold alias values, the words of the value, name, */
+/* value and the text of the words follow it in memory            */
 typedef struct alias_t
 {
-    char    name[NAME_LIMIT];
-    char    value[VALUE_LIMIT];
+    char*           name;
+    char*           value;
+    int             n_words;    /* value split into words once, when */
+    char**          words;      /* the alias is added                */
+    token_kind*     kinds;
+    struct alias_t* retired;    /* next alias waiting to be freed    */
 } alias;
 
+/* structure to hold every alias */
+typedef struct alias_table_t
+{
+    hash_table  aliases;        /* keyed by name                     */
+    alias**     sorted;         /* view for print_aliases()          */
+    unsigned long sorted_generation;
+    alias*      retired;        /* removed, freed when the line ends */
+} alias_table;
+
+/* globals */
+extern unsigned long alias_generation;    /* bumped on every change */
+
 /* prototypes */
 int     add_alias( char*, char* );
 int     remove_alias( const char* );
 alias*  find_alias( const char* );
-void    adjust_aliases( alias* );
-void    print_aliases( void );
+void    print_aliases( FILE* );
+void    release_aliases( void );
+void    free_aliases( void );
 int     alias_cmp( const void*, const void* );
 
 #endif
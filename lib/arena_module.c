@@ -0,0 +1,224 @@
+#include "arena_module.h"
+
+/* globals */
+arena   line_arena = { NULL, NULL, 0, 0, 0 };
+
+/* static function prototypes */
+static arena_block*    new_block( size_t size );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: arena_alloc                                   */
+/*      Return type:   void* (NULL on failure)                       */
+/*      Parameter(s):                                                */
+/*          arena* a: arena to allocate from                         */
+/*          size_t size: number of bytes needed                      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          hands out size bytes from the current block, moving on   */
+/*          to a new block when the current one is full.             */
+/*                                                                   */
+/*********************************************************************/
+void* arena_alloc( arena* a, size_t size )
+{
+    arena_block* block;
+    void* ptr;
+
+    // keep every allocation aligned
+    size = ( size + ARENA_ALIGN - 1 ) & ~( (size_t)ARENA_ALIGN - 1 );
+
+    // first allocation ever
+    if( a->head == NULL )
+    {
+        if( ( a->head = new_block( size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE ) ) == NULL )
+            return NULL;
+        a->current = a->head;
+    }
+
+    // current block is full, chain another one
+    if( a->current->used + size > a->current->size )
+    {
+        if( ( block = new_block( size > a->current->size ? size : a->current->size * 2 ) ) == NULL )
+            return NULL;
+        a->current->next = block;
+        a->current = block;
+    }
+
+    ptr = &a->current->data[a->current->used];
+    a->current->used += size;
+
+    // keep track of the most we have needed for one line
+    if( ( a->used += size ) > a->high_water )
+        a->high_water = a->used;
+
+    return ptr;
+} /* end arena_alloc() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: arena_strdup                                  */
+/*      Return type:   char* (NULL on failure)                       */
+/*      Parameter(s):                                                */
+/*          arena* a: arena to allocate from                         */
+/*          const char* str: string to copy                          */
+/*                                                                   */
+/*********************************************************************/
+char* arena_strdup( arena* a, const char* str )
+{
+    return arena_strndup( a, str, strlen( str ) );
+} /* end arena_strdup() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: arena_strndup                                 */
+/*      Return type:   char* (NULL on failure)                       */
+/*      Parameter(s):                                                */
+/*          arena* a: arena to allocate from                         */
+/*          const char* str: string to copy                          */
+/*          size_t length: number of characters to copy              */
+/*                                                                   */
+/*      Description:                                                 */
+/*          copies length characters of str and NUL terminates them, */
+/*          str does not need to be NUL terminated.                  */
+/*                                                                   */
+/*********************************************************************/
+char* arena_strndup( arena* a, const char* str, size_t length )
+{
+    char* copy;
+
+    if( ( copy = (char*)arena_alloc( a, ( length + 1 ) * sizeof(char) ) ) == NULL )
+    {
+        fprintf( stderr, "Error: could not allocate memory for word - %.*s\n", (int)length, str );
+        return NULL;
+    }
+
+    memcpy( copy, str, length * sizeof(char) );
+    copy[length] = '\0';
+
+    return copy;
+} /* end arena_strndup() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: arena_reset                                   */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          arena* a: arena to reset                                 */
+/*                                                                   */
+/*      Description:                                                 */
+/*          gives back everything allocated from the arena. When a   */
+/*          line did not fit in the first block, the first block is  */
+/*          replaced by one as big as the high water mark so the     */
+/*          next lines fit without chaining. After many lines that   */
+/*          used little of a big first block it is halved, so one    */
+/*          huge line does not keep its memory for the rest of the   */
+/*          session. Otherwise this is O(1).                         */
+/*                                                                   */
+/*********************************************************************/
+void arena_reset( arena* a )
+{
+    arena_block* block, * next;
+
+    if( a->head == NULL )
+        return;
+
+    // line overflowed the first block, grow it to the high water mark
+    if( a->head->next != NULL )
+    {
+        for( block = a->head; block != NULL; block = next )
+        {
+            next = block->next;
+            free( block );
+        }
+
+        if( ( a->head = new_block( a->high_water ) ) == NULL )
+            fprintf( stderr, "Error: could not grow arena to %lu bytes\n", (unsigned long)a->high_water );
+        a->small_lines = 0;
+    }
+    // lines have stayed far below a big first block, halve it
+    else if( a->head->size > ARENA_BLOCK_SIZE && a->used < a->head->size / 4 &&
+             ++a->small_lines >= ARENA_SHRINK_RESETS )
+    {
+        a->high_water = ( a->head->size / 2 > ARENA_BLOCK_SIZE ? a->head->size / 2 : ARENA_BLOCK_SIZE );
+        free( a->head );
+
+        if( ( a->head = new_block( a->high_water ) ) == NULL )
+            fprintf( stderr, "Error: could not shrink arena to %lu bytes\n", (unsigned long)a->high_water );
+        a->small_lines = 0;
+    }
+    else
+    {
+        if( a->used >= a->head->size / 4 )
+            a->small_lines = 0;
+        a->head->used = 0;
+    }
+
+    a->current = a->head;
+    a->used = 0;
+} /* end arena_reset() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: arena_free                                    */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          arena* a: arena to free                                  */
+/*                                                                   */
+/*      Description:                                                 */
+/*          frees every block of the arena.                          */
+/*                                                                   */
+/*********************************************************************/
+void arena_free( arena* a )
+{
+    arena_block* block, * next;
+
+    for( block = a->head; block != NULL; block = next )
+    {
+        next = block->next;
+        free( block );
+    }
+
+    a->head = a->current = NULL;
+    a->used = a->high_water = 0;
+    a->small_lines = 0;
+} /* end arena_free() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: new_block                                     */
+/*      Return type:   arena_block* (NULL on failure)                */
+/*      Parameter(s):                                                */
+/*          size_t size: usable bytes in the block                   */
+/*                                                                   */
+/*********************************************************************/
+static arena_block* new_block( size_t size )
+{
+    arena_block* block;
+
+    if( size < ARENA_BLOCK_SIZE )
+        size = ARENA_BLOCK_SIZE;
+
+    if( ( block = (arena_block*)malloc( sizeof(arena_block) + size ) ) == NULL )
+    {
+        fprintf( stderr, "Error: could not allocate %lu bytes for arena\n", (unsigned long)size );
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+
+    return block;
+} /* end new_block() */
@@ -0,0 +1,54 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: arena_module.h                              */
+/*          Description:                                             */
+/*              This module provides a bump allocator that owns      */
+/*              every string of one command line. Nothing in it is   */
+/*              freed on its own, the whole arena is reset at once.  */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef ARENA_MODULE_H
+#define ARENA_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* macros */
+#define ARENA_BLOCK_SIZE 4096
+#define ARENA_ALIGN 16
+#define ARENA_SHRINK_RESETS 64  /* lines in a row using under a quarter */
+                                /* of the first block before it halves  */
+
+/* one chunk of memory handed out by the arena */
+typedef struct arena_block_t
+{
+    struct arena_block_t*   next;
+    size_t                  size;
+    size_t                  used;
+    _Alignas(ARENA_ALIGN) char data[];
+} arena_block;
+
+/* structure to hold the arena */
+typedef struct arena_t
+{
+    arena_block*    head;       /* first block, kept across resets   */
+    arena_block*    current;    /* block we are allocating from      */
+    size_t          used;       /* bytes handed out since last reset */
+    size_t          high_water; /* most bytes used by one line, it   */
+                                /* decays as the first block shrinks */
+    int             small_lines; /* resets in a row far below it    */
+} arena;
+
+/* globals */
+extern arena line_arena;
+
+/* function prototypes */
+void*   arena_alloc( arena* a, size_t size );
+char*   arena_strdup( arena* a, const char* str );
+char*   arena_strndup( arena* a, const char* str, size_t length );
+void    arena_reset( arena* a );
+void    arena_free( arena* a );
+
+#endif
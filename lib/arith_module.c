@@ -0,0 +1,515 @@
+#include "arith_module.h"
+
+/* binary operators, two character ones first so "<<" is not "<" */
+static const struct
+{
+    const char* text;
+    size_t      length;
+    int         precedence;     /* higher binds tighter */
+    arith_op    op;
+} operators[] =
+{
+    { "||", 2, 1, ARITH_OR },
+    { "&&", 2, 2, ARITH_AND },
+    { "==", 2, 6, ARITH_EQUAL },
+    { "!=", 2, 6, ARITH_NOT_EQUAL },
+    { "<=", 2, 7, ARITH_LESS_EQUAL },
+    { ">=", 2, 7, ARITH_GREATER_EQUAL },
+    { "<<", 2, 8, ARITH_SHIFT_LEFT },
+    { ">>", 2, 8, ARITH_SHIFT_RIGHT },
+    { "**", 2, 11, ARITH_POWER },
+    { "|",  1, 3, ARITH_BIT_OR },
+    { "^",  1, 4, ARITH_BIT_XOR },
+    { "&",  1, 5, ARITH_BIT_AND },
+    { "<",  1, 7, ARITH_LESS },
+    { ">",  1, 7, ARITH_GREATER },
+    { "+",  1, 9, ARITH_ADD },
+    { "-",  1, 9, ARITH_SUBTRACT },
+    { "*",  1, 10, ARITH_MULTIPLY },
+    { "/",  1, 10, ARITH_DIVIDE },
+    { "%",  1, 10, ARITH_REMAINDER }
+};
+
+/* static function prototypes */
+static int     parse_assignment( arith_parser* p, long* value );
+static int     parse_conditional( arith_parser* p, long* value );
+static int     parse_binary( arith_parser* p, int min_precedence, long* value );
+static int     parse_unary( arith_parser* p, long* value );
+static int     parse_primary( arith_parser* p, long* value );
+static int     find_operator( arith_parser* p );
+static int     apply_operator( arith_parser* p, arith_op op, long* left, long right );
+static int     variable_number( arith_parser* p, const char* name, size_t length, long* value );
+static void    skip_blanks( arith_parser* p );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: arith_evaluate                                */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* expression: text between $(( and ))          */
+/*          long* result: set to the value of expression             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          evaluates expression in a single pass, by recursive      */
+/*          descent. An empty expression is 0.                       */
+/*                                                                   */
+/*********************************************************************/
+int arith_evaluate( const char* expression, long* result )
+{
+    arith_parser p = { expression, 0, 0 };
+
+    skip_blanks( &p );
+    if( expression[p.pos] == '\0' )
+    {
+        *result = 0;
+        return SUCCESS;
+    }
+
+    if( parse_assignment( &p, result ) == FAILURE )
+        return FAILURE;
+
+    skip_blanks( &p );
+    if( expression[p.pos] != '\0' )
+    {
+        fprintf( stderr, "Error: arithmetic syntax error near '%s' - %s\n", &expression[p.pos], expression );
+        return FAILURE;
+    }
+
+    return SUCCESS;
+} /* end arith_evaluate() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: parse_assignment                              */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          arith_parser* p: parser                                  */
+/*          long* value: set to the value of the expression          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          NAME = expr, NAME += expr (and -= *= /= %=), or a        */
+/*          conditional expression. Assignments group to the right.  */
+/*                                                                   */
+/*********************************************************************/
+static int parse_assignment( arith_parser* p, long* value )
+{
+    const char* name;
+    char number[24], c;
+    size_t start = p->pos, length;
+    long right;
+    arith_op op = ARITH_ADD;
+    int compound = F;
+
+    skip_blanks( p );
+    name = &p->text[p->pos];
+
+    if( ( length = variable_name_length( name ) ) > 0 )
+    {
+        p->pos += length;
+        skip_blanks( p );
+
+        // "+=" and the like use the value the variable has
+        c = p->text[p->pos];
+        if( c != '\0' && strchr( "+-*/%", c ) != NULL && p->text[p->pos + 1] == '=' )
+        {
+            compound = T;
+            op = ( c == '+' ? ARITH_ADD : c == '-' ? ARITH_SUBTRACT : c == '*' ? ARITH_MULTIPLY :
+                   c == '/' ? ARITH_DIVIDE : ARITH_REMAINDER );
+            p->pos++;
+        }
+
+        if( p->text[p->pos] == '=' && p->text[p->pos + 1] != '=' )
+        {
+            p->pos++;
+            if( parse_assignment( p, &right ) == FAILURE )
+                return FAILURE;
+
+            if( !compound )
+                *value = right;
+            else if( variable_number( p, name, length, value ) == FAILURE ||
+                     apply_operator( p, op, value, right ) == FAILURE )
+                return FAILURE;
+
+            if( p->skip > 0 )
+                return SUCCESS;
+
+            snprintf( number, sizeof(number), "%ld", *value );
+            return set_variable( name, length, number, VAR_KEEP );
+        }
+    }
+
+    // not an assignment, read it again as an expression
+    p->pos = start;
+    return parse_conditional( p, value );
+} /* end parse_assignment() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: parse_conditional                             */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          arith_parser* p: parser                                  */
+/*          long* value: set to the value of the expression          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          condition ? expr : expr, only the side that is picked    */
+/*          is evaluated.                                            */
+/*                                                                   */
+/*********************************************************************/
+static int parse_conditional( arith_parser* p, long* value )
+{
+    long condition, other;
+    int skip_true, skip_false;
+
+    if( parse_binary( p, 1, &condition ) == FAILURE )
+        return FAILURE;
+
+    skip_blanks( p );
+    if( p->text[p->pos] != '?' )
+    {
+        *value = condition;
+        return SUCCESS;
+    }
+    p->pos++;
+
+    skip_true = ( condition == 0 );
+    skip_false = !skip_true;
+
+    p->skip += skip_true;
+    if( parse_assignment( p, ( skip_true ? &other : value ) ) == FAILURE )
+        return FAILURE;
+    p->skip -= skip_true;
+
+    skip_blanks( p );
+    if( p->text[p->pos] != ':' )
+    {
+        fprintf( stderr, "Error: arithmetic syntax error, ':' missing - %s\n", p->text );
+        return FAILURE;
+    }
+    p->pos++;
+
+    p->skip += skip_false;
+    if( parse_conditional( p, ( skip_false ? &other : value ) ) == FAILURE )
+        return FAILURE;
+    p->skip -= skip_false;
+
+    return SUCCESS;
+} /* end parse_conditional() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: parse_binary                                  */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          arith_parser* p: parser                                  */
+/*          int min_precedence: weakest operator to take             */
+/*          long* value: set to the value of the expression          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          operands joined by binary operators, read by precedence  */
+/*          climbing. ** groups to the right, the rest to the left.  */
+/*          The right side of && and || is only evaluated when it    */
+/*          decides the result.                                      */
+/*                                                                   */
+/*********************************************************************/
+static int parse_binary( arith_parser* p, int min_precedence, long* value )
+{
+    long right;
+    int i, unused;
+
+    if( parse_unary( p, value ) == FAILURE )
+        return FAILURE;
+
+    while( ( i = find_operator( p ) ) != -1 && operators[i].precedence >= min_precedence )
+    {
+        p->pos += operators[i].length;
+
+        unused = ( operators[i].op == ARITH_AND && *value == 0 ) ||
+                 ( operators[i].op == ARITH_OR && *value != 0 );
+
+        p->skip += unused;
+        if( parse_binary( p, operators[i].precedence + ( operators[i].op != ARITH_POWER ), &right ) == FAILURE )
+            return FAILURE;
+        p->skip -= unused;
+
+        if( apply_operator( p, operators[i].op, value, right ) == FAILURE )
+            return FAILURE;
+    }
+
+    return SUCCESS;
+} /* end parse_binary() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: parse_unary                                   */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          arith_parser* p: parser                                  */
+/*          long* value: set to the value of the operand             */
+/*                                                                   */
+/*********************************************************************/
+static int parse_unary( arith_parser* p, long* value )
+{
+    char op;
+
+    skip_blanks( p );
+    op = p->text[p->pos];
+
+    if( op != '-' && op != '+' && op != '!' && op != '~' )
+        return parse_primary( p, value );
+
+    p->pos++;
+    if( parse_unary( p, value ) == FAILURE )
+        return FAILURE;
+
+    switch( op )
+    {
+        case '-': *value = (long)( 0UL - (unsigned long)*value ); break;
+        case '!': *value = !*value; break;
+        case '~': *value = ~*value; break;
+        default:  break;
+    }
+
+    return SUCCESS;
+} /* end parse_unary() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: parse_primary                                 */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          arith_parser* p: parser                                  */
+/*          long* value: set to the value of the operand             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          a number (10, 0x1f or 017), a variable name or an        */
+/*          expression in parentheses.                               */
+/*                                                                   */
+/*********************************************************************/
+static int parse_primary( arith_parser* p, long* value )
+{
+    const char* start = &p->text[p->pos];
+    char* end;
+    size_t length;
+
+    if( *start == '(' )
+    {
+        p->pos++;
+        if( parse_assignment( p, value ) == FAILURE )
+            return FAILURE;
+
+        skip_blanks( p );
+        if( p->text[p->pos] != ')' )
+        {
+            fprintf( stderr, "Error: arithmetic syntax error, ')' missing - %s\n", p->text );
+            return FAILURE;
+        }
+        p->pos++;
+        return SUCCESS;
+    }
+
+    if( isdigit( (unsigned char)*start ) )
+    {
+        *value = strtol( start, &end, 0 );
+        if( isalnum( (unsigned char)*end ) || *end == '_' )
+        {
+            fprintf( stderr, "Error: bad number in arithmetic - %s\n", p->text );
+            return FAILURE;
+        }
+        p->pos += (size_t)( end - start );
+        return SUCCESS;
+    }
+
+    if( ( length = variable_name_length( start ) ) > 0 )
+    {
+        p->pos += length;
+        return variable_number( p, start, length, value );
+    }
+
+    if( *start == '\0' )
+        fprintf( stderr, "Error: arithmetic syntax error, operand missing - %s\n", p->text );
+    else
+        fprintf( stderr, "Error: arithmetic syntax error near '%s' - %s\n", start, p->text );
+
+    return FAILURE;
+} /* end parse_primary() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_operator                                 */
+/*      Return type:   int - index in operators, -1 if none          */
+/*      Parameter(s):                                                */
+/*          arith_parser* p: parser                                  */
+/*                                                                   */
+/*      Description:                                                 */
+/*          looks for a binary operator at the current position,     */
+/*          without moving past it.                                  */
+/*                                                                   */
+/*********************************************************************/
+static int find_operator( arith_parser* p )
+{
+    const char* text;
+    size_t i;
+
+    skip_blanks( p );
+    text = &p->text[p->pos];
+
+    for( i = 0; i < sizeof( operators ) / sizeof( operators[0] ); i++ )
+    {
+        if( strncmp( text, operators[i].text, operators[i].length ) == 0 )
+        {
+            // "x += 1" inside an expression is an error, not x + (= 1)
+            if( text[operators[i].length] == '=' && operators[i].length == 1 &&
+                operators[i].op != ARITH_LESS && operators[i].op != ARITH_GREATER )
+                return -1;
+            return (int)i;
+        }
+    }
+
+    return -1;
+} /* end find_operator() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: apply_operator                                */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          arith_parser* p: parser, for errors                      */
+/*          arith_op op: operator                                    */
+/*          long* left: left operand, set to the result              */
+/*          long right: right operand                                */
+/*                                                                   */
+/*      Description:                                                 */
+/*          + - * ** and << wrap around instead of overflowing, and  */
+/*          shift counts only use their low 6 bits.                  */
+/*                                                                   */
+/*********************************************************************/
+static int apply_operator( arith_parser* p, arith_op op, long* left, long right )
+{
+    unsigned long l = (unsigned long)*left, r = (unsigned long)right, power = 1;
+
+    if( ( op == ARITH_DIVIDE || op == ARITH_REMAINDER ) && right == 0 )
+    {
+        // a division that is never used is allowed to be by zero
+        if( p->skip > 0 )
+            return SUCCESS;
+
+        fprintf( stderr, "Error: division by zero - %s\n", p->text );
+        return FAILURE;
+    }
+
+    if( op == ARITH_POWER && right < 0 )
+    {
+        if( p->skip > 0 )
+            return SUCCESS;
+
+        fprintf( stderr, "Error: negative exponent - %s\n", p->text );
+        return FAILURE;
+    }
+
+    switch( op )
+    {
+        case ARITH_OR:              *left = ( *left != 0 || right != 0 ); break;
+        case ARITH_AND:             *left = ( *left != 0 && right != 0 ); break;
+        case ARITH_BIT_OR:          *left |= right; break;
+        case ARITH_BIT_XOR:         *left ^= right; break;
+        case ARITH_BIT_AND:         *left &= right; break;
+        case ARITH_EQUAL:           *left = ( *left == right ); break;
+        case ARITH_NOT_EQUAL:       *left = ( *left != right ); break;
+        case ARITH_LESS:            *left = ( *left < right ); break;
+        case ARITH_LESS_EQUAL:      *left = ( *left <= right ); break;
+        case ARITH_GREATER:         *left = ( *left > right ); break;
+        case ARITH_GREATER_EQUAL:   *left = ( *left >= right ); break;
+        case ARITH_SHIFT_LEFT:      *left = (long)( l << ( r & 63 ) ); break;
+        case ARITH_SHIFT_RIGHT:     *left >>= ( r & 63 ); break;
+        case ARITH_ADD:             *left = (long)( l + r ); break;
+        case ARITH_SUBTRACT:        *left = (long)( l - r ); break;
+        case ARITH_MULTIPLY:        *left = (long)( l * r ); break;
+        // LONG_MIN / -1 does not fit, negating wraps around instead
+        case ARITH_DIVIDE:          *left = ( right == -1 ? (long)( 0UL - l ) : *left / right ); break;
+        case ARITH_REMAINDER:       *left = ( right == -1 ? 0 : *left % right ); break;
+        case ARITH_POWER:
+            // square and multiply, wrapping around like *
+            for( ; r > 0; r >>= 1, l *= l )
+            {
+                if( r & 1 )
+                    power *= l;
+            }
+            *left = (long)power;
+            break;
+    }
+
+    return SUCCESS;
+} /* end apply_operator() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: variable_number                               */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          arith_parser* p: parser, for errors                      */
+/*          const char* name: name of the variable, not terminated   */
+/*          size_t length: length of name                            */
+/*          long* value: set to the number the variable holds        */
+/*                                                                   */
+/*      Description:                                                 */
+/*          an unset or empty variable is 0, anything else must be   */
+/*          a number.                                                */
+/*                                                                   */
+/*********************************************************************/
+static int variable_number( arith_parser* p, const char* name, size_t length, long* value )
+{
+    const char* text = get_variable_n( name, length );
+    char* end;
+
+    *value = 0;
+    if( text == NULL )
+        return SUCCESS;
+
+    while( isspace( (unsigned char)*text ) )
+        text++;
+    if( *text == '\0' )
+        return SUCCESS;
+
+    *value = strtol( text, &end, 0 );
+    while( isspace( (unsigned char)*end ) )
+        end++;
+
+    if( *end != '\0' )
+    {
+        fprintf( stderr, "Error: %.*s is not a number - %s\n", (int)length, name, p->text );
+        return FAILURE;
+    }
+
+    return SUCCESS;
+} /* end variable_number() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: skip_blanks                                   */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          arith_parser* p: parser                                  */
+/*                                                                   */
+/*********************************************************************/
+static void skip_blanks( arith_parser* p )
+{
+    while( isspace( (unsigned char)p->text[p->pos] ) )
+        p->pos++;
+} /* end skip_blanks() */
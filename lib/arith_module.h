@@ -0,0 +1,55 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: arith_module.h                              */
+/*          Description:                                             */
+/*              This module evaluates the integer expressions of     */
+/*              $(( )) inside the shell, with the operators and      */
+/*              precedence of C. Names in an expression are shell    */
+/*              variables, and "i = i + 1" or "i += 1" sets one.     */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef ARITH_MODULE_H
+#define ARITH_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "string_module.h"
+#include "variable_module.h"
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* binary operators, the ones in the same group share a precedence */
+typedef enum arith_op_t
+{
+    ARITH_OR, ARITH_AND,
+    ARITH_BIT_OR, ARITH_BIT_XOR, ARITH_BIT_AND,
+    ARITH_EQUAL, ARITH_NOT_EQUAL,
+    ARITH_LESS, ARITH_LESS_EQUAL, ARITH_GREATER, ARITH_GREATER_EQUAL,
+    ARITH_SHIFT_LEFT, ARITH_SHIFT_RIGHT,
+    ARITH_ADD, ARITH_SUBTRACT,
+    ARITH_MULTIPLY, ARITH_DIVIDE, ARITH_REMAINDER,
+    ARITH_POWER
+} arith_op;
+
+/* where the parser is in the expression */
+typedef struct arith_parser_t
+{
+    const char* text;
+    size_t      pos;
+    int         skip;       /* > 0 on the side of && || ?: that is */
+                            /* not used, where nothing is assigned */
+                            /* and dividing by zero is no error    */
+} arith_parser;
+
+/* function prototypes */
+int     arith_evaluate( const char* expression, long* result );
+
+#endif
@@ -0,0 +1,297 @@
+#include "cache_module.h"
+
+/* globals */
+static cache_entry*     buckets[CACHE_BUCKETS];
+static cache_entry*     newest = NULL;
+static cache_entry*     oldest = NULL;
+static int              n_entries = 0;
+static unsigned long    cache_generation = 0;   /* alias_generation the entries were made with */
+static cache_stats      stats = { 0, 0, 0, 0 };
+
+/* static function prototypes */
+static cache_entry*    find_entry( const char* line, uint64_t hash, size_t length );
+static void            remove_entry( cache_entry* e );
+static void            move_to_front( cache_entry* e );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: cache_lookup                                  */
+/*      Return type:   int (SUCCESS on a hit, FAILURE on a miss)     */
+/*      Parameter(s):                                                */
+/*          const char* line: raw line the user entered              */
+/*          word_vector* words: filled with the expanded words       */
+/*          command_list* list: filled with the parsed line          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          looks line up in the cache. On a hit the word pointers   */
+/*          are copied into words, so expanding variables later      */
+/*          replaces them there and leaves the cached words alone.   */
+/*          The list arrays point into the cache, which is only      */
+/*          changed between lines.                                   */
+/*                                                                   */
+/*********************************************************************/
+int cache_lookup( const char* line, word_vector* words, command_list* list )
+{
+    cache_entry* e;
+    uint64_t hash;
+    size_t length;
+
+    // aliases changed since the lines were expanded
+    if( cache_generation != alias_generation )
+    {
+        if( n_entries > 0 )
+        {
+            cache_clear();
+            stats.invalidations++;
+        }
+        cache_generation = alias_generation;
+    }
+
+    hash = hash_string( line, &length );
+
+    if( ( e = find_entry( line, hash, length ) ) == NULL ||
+        reserve_strings( words, e->n_words ) == FAILURE )
+    {
+        stats.misses++;
+        return FAILURE;
+    }
+
+    // copy the words, including the NULL after them
+    memcpy( words->words, e->words, ( e->n_words + 1 ) * sizeof(char*) );
+    memcpy( words->kinds, e->kinds, e->n_words * sizeof(token_kind) );
+    words->count = e->n_words;
+
+    *list = e->list;
+    list->words = words;
+
+    move_to_front( e );
+    stats.hits++;
+
+    return SUCCESS;
+} /* end cache_lookup() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: cache_store                                   */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* line: raw line the user entered              */
+/*          word_vector* words: expanded words of line               */
+/*          command_list* list: parsed line                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          copies line, its words and list into one block and adds  */
+/*          it as the most recently used entry, dropping the least   */
+/*          recently used one if the cache is full. Must be called   */
+/*          before any variables are expanded.                       */
+/*                                                                   */
+/*********************************************************************/
+int cache_store( const char* line, word_vector* words, command_list* list )
+{
+    cache_entry* e;
+    char* text;
+    size_t length, size, word_length;
+    uint64_t hash = hash_string( line, &length );
+    int i;
+
+    if( length > CACHE_LINE_LIMIT )
+        return FAILURE;
+
+    // make room
+    if( n_entries == CACHE_SIZE )
+    {
+        remove_entry( oldest );
+        stats.evictions++;
+    }
+
+    // arrays of pointers first, then arrays of ints, then characters
+    // so everything in the block is aligned
+    size = sizeof(cache_entry) + ( words->count + 1 ) * sizeof(char*) +
+           list->n_pipelines * sizeof(pipeline) + list->n_commands * sizeof(command) +
+           list->n_redirects * sizeof(redirect) + list->n_args * sizeof(int) +
+           words->count * sizeof(token_kind) + length + 1;
+
+    for( i = 0; i < words->count; i++ )
+        size += strlen( words->words[i] ) + 1;
+
+    if( ( e = (cache_entry*)malloc( size ) ) == NULL )
+        return FAILURE;
+
+    e->hash = hash;
+    e->length = length;
+    e->n_words = words->count;
+    e->list = *list;
+    e->list.words = NULL;
+
+    e->words = (char**)( e + 1 );
+    e->list.pipelines = (pipeline*)( e->words + words->count + 1 );
+    e->list.commands = (command*)( e->list.pipelines + list->n_pipelines );
+    e->list.redirects = (redirect*)( e->list.commands + list->n_commands );
+    e->list.args = (int*)( e->list.redirects + list->n_redirects );
+    e->kinds = (token_kind*)( e->list.args + list->n_args );
+    e->line = (char*)( e->kinds + words->count );
+
+    memcpy( e->list.pipelines, list->pipelines, list->n_pipelines * sizeof(pipeline) );
+    memcpy( e->list.commands, list->commands, list->n_commands * sizeof(command) );
+    memcpy( e->list.redirects, list->redirects, list->n_redirects * sizeof(redirect) );
+    memcpy( e->list.args, list->args, list->n_args * sizeof(int) );
+    memcpy( e->kinds, words->kinds, words->count * sizeof(token_kind) );
+    memcpy( e->line, line, length + 1 );
+
+    // words go right after the line
+    text = e->line + length + 1;
+    for( i = 0; i < words->count; i++ )
+    {
+        word_length = strlen( words->words[i] ) + 1;
+        memcpy( text, words->words[i], word_length );
+        e->words[i] = text;
+        text += word_length;
+    }
+    e->words[i] = NULL;
+
+    // add to its bucket and to the front of the LRU list
+    e->next = buckets[e->hash & ( CACHE_BUCKETS - 1 )];
+    buckets[e->hash & ( CACHE_BUCKETS - 1 )] = e;
+
+    e->newer = NULL;
+    e->older = newest;
+    if( newest != NULL )
+        newest->newer = e;
+    newest = e;
+    if( oldest == NULL )
+        oldest = e;
+
+    n_entries++;
+
+    return SUCCESS;
+} /* end cache_store() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: cache_clear                                   */
+/*      Return type:   none                                          */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          frees every entry. Words handed out by cache_lookup()    */
+/*          must not be in use any more.                             */
+/*                                                                   */
+/*********************************************************************/
+void cache_clear( void )
+{
+    while( oldest != NULL )
+        remove_entry( oldest );
+} /* end cache_clear() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: print_cache_stats                             */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          FILE* stream: where the counters are printed             */
+/*                                                                   */
+/*********************************************************************/
+void print_cache_stats( FILE* stream )
+{
+    fprintf( stream, "hits\t%lu\n", stats.hits );
+    fprintf( stream, "misses\t%lu\n", stats.misses );
+    fprintf( stream, "evictions\t%lu\n", stats.evictions );
+    fprintf( stream, "invalidations\t%lu\n", stats.invalidations );
+    fprintf( stream, "entries\t%d/%d\n", n_entries, CACHE_SIZE );
+} /* end print_cache_stats() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_entry                                    */
+/*      Return type:   cache_entry* (NULL if not found)              */
+/*      Parameter(s):                                                */
+/*          const char* line: raw line                               */
+/*          uint64_t hash: hash of line                              */
+/*          size_t length: length of line                            */
+/*                                                                   */
+/*********************************************************************/
+static cache_entry* find_entry( const char* line, uint64_t hash, size_t length )
+{
+    cache_entry* e;
+
+    for( e = buckets[hash & ( CACHE_BUCKETS - 1 )]; e != NULL; e = e->next )
+    {
+        // the line itself is compared so a collision is just a miss
+        if( e->hash == hash && e->length == length && memcmp( e->line, line, length ) == 0 )
+            return e;
+    }
+
+    return NULL;
+} /* end find_entry() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: remove_entry                                  */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          cache_entry* e: entry to unlink and free                 */
+/*                                                                   */
+/*********************************************************************/
+static void remove_entry( cache_entry* e )
+{
+    cache_entry** link = &buckets[e->hash & ( CACHE_BUCKETS - 1 )];
+
+    // unlink from its bucket
+    while( *link != e )
+        link = &(*link)->next;
+    *link = e->next;
+
+    // unlink from the LRU list
+    if( e->newer != NULL )
+        e->newer->older = e->older;
+    else
+        newest = e->older;
+
+    if( e->older != NULL )
+        e->older->newer = e->newer;
+    else
+        oldest = e->newer;
+
+    n_entries--;
+    free( e );
+} /* end remove_entry() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: move_to_front                                 */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          cache_entry* e: entry that was just used                 */
+/*                                                                   */
+/*********************************************************************/
+static void move_to_front( cache_entry* e )
+{
+    if( e == newest )
+        return;
+
+    // unlink, e has a newer neighbour since it is not the newest
+    e->newer->older = e->older;
+    if( e->older != NULL )
+        e->older->newer = e->newer;
+    else
+        oldest = e->newer;
+
+    // relink at the front
+    e->newer = NULL;
+    e->older = newest;
+    newest->newer = e;
+    newest = e;
+} /* end move_to_front() */
@@ -0,0 +1,67 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: cache_module.h                              */
+/*          Description:                                             */
+/*              This module remembers recently entered command       */
+/*              lines after they have been tokenized, had their      */
+/*              aliases expanded and been parsed, so running the     */
+/*              same line again skips all three. The least recently  */
+/*              used line is dropped when the cache is full, and the */
+/*              whole cache is dropped when the aliases change.      */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef CACHE_MODULE_H
+#define CACHE_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "string_module.h"
+#include "parse_module.h"
+#include "alias_module.h"
+
+/* macros */
+#define CACHE_SIZE 64           /* lines kept                        */
+#define CACHE_BUCKETS 128       /* hash buckets, a power of 2        */
+#define CACHE_LINE_LIMIT 1024   /* longer lines are not worth a slot */
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* one parsed line, allocated as a single block */
+typedef struct cache_entry_t
+{
+    struct cache_entry_t*   next;       /* next entry in the same bucket */
+    struct cache_entry_t*   newer;      /* neighbours in the LRU list    */
+    struct cache_entry_t*   older;
+    uint64_t                hash;
+    size_t                  length;     /* length of line                */
+    char*                   line;       /* raw line, checked on a hit    */
+    int                     n_words;
+    char**                  words;      /* alias expanded words          */
+    token_kind*             kinds;
+    command_list            list;       /* list.words is not used        */
+} cache_entry;
+
+/* how well the cache is doing */
+typedef struct cache_stats_t
+{
+    unsigned long   hits;
+    unsigned long   misses;
+    unsigned long   evictions;
+    unsigned long   invalidations;
+} cache_stats;
+
+/* function prototypes */
+int     cache_lookup( const char* line, word_vector* words, command_list* list );
+int     cache_store( const char* line, word_vector* words, command_list* list );
+void    cache_clear( void );
+void    print_cache_stats( FILE* stream );
+
+#endif
@@ -1,227 +1,1040 @@
 #include "execution_module.h"
 
 /* static function prototypes */
-static int     generate_process( int fd_in, int fd_out, char* prog[] );
-static void    execute_and_pipe( int n_pipes, int pipe_loc[], int fd_in, int fd_out );
+static pid_t   generate_process( int fd_in, int fd_out, command_list* list, command* cmd );
+static int     wait_for_processes( pid_t* pids, int n );
+static pid_t   fork_program( int fd_in, int fd_out, command_list* list, command* cmd,
+                             char* path, char** envp, long method );
+static void    run_child( int fd_in, int fd_out, command_list* list, command* cmd,
+                          char* path, char** envp, int report_fd );
+static void    fail_child( int report_fd, child_error* report );
+static pid_t   spawn_program( int fd_in, int fd_out, command_list* list, command* cmd,
+                              char* path, char** envp );
+static int     has_descriptor( command_list* list, command* cmd, int n, int fd,
+                               int* closed, int n_closed );
+static int     set_by_redirect( command_list* list, command* cmd, int n, int fd );
+static int     execute_and_pipe( command_list* list, pipeline* pl );
+static int     find_pipe_size( command_list* list, pipeline* pl, long* size );
+static int     execute_builtin( command_list* list, command* cmd );
+static int     apply_redirects( command_list* list, command* cmd, int* failed );
+static int     open_redirect( redirect* r, const char* file, int flags );
+static int     assign_variables( command_list* list, command* cmd );
+static char**  build_envp( command_list* list, command* cmd );
+static char*   find_program( const char* name );
+static void    exec_script( const char* path, int argc, char** argv, char** envp );
+static void    report_redirect( command_list* list, redirect* r );
+static void    report_not_run( const char* name, int error );
 
 
 /*********************************************************************/
 /*                                                                   */
 /*      Function name: execute                                       */
-/*      Return type:   void                                          */
-/*      Parameter(s):  None                                          */
+/*      Return type:   int - exit status of the last command         */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          pipeline* pl: pipeline of list to run                    */
+/*                                                                   */
+/*      Description:                                                 */
+/*          executes a pipeline entered in the command line by user. */
+/*                                                                   */
+/*********************************************************************/
+int execute( command_list* list, pipeline* pl )
+{
+    command* cmd = &list->commands[pl->first_command];
+    arguments* args = &list->expanded[pl->first_command];
+    pid_t pid;
+    long size;
+
+    // handle pipelines if needed
+    if( pl->n_commands > 1 )
+        return execute_and_pipe( list, pl );
+
+    // without a pipe the size is only checked
+    if( pl->size_word != -1 && find_pipe_size( list, pl, &size ) == FAILURE )
+        return 1;
+
+    // a builtin on its own runs in the shell, so cd and alias
+    // change the shell itself and not a child process, and so
+    // does a command that only sets variables, e.g. "x=1"
+    if( cmd->builtin != BUILTIN_NONE || args->argc == 0 )
+        return execute_builtin( list, cmd );
+
+    // spawn process and execute prog
+    pid = generate_process( STDIN_FILENO, STDOUT_FILENO, list, cmd );
+    return ( pid < 0 ? 1 : wait_for_processes( &pid, 1 ) );
+}/* end execute() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: open_for_shell                                */
+/*      Return type:   int - the descriptor, -1 on failure           */
+/*      Parameter(s):                                                */
+/*          const char* path: file to open                           */
+/*          int flags: flags of open()                               */
+/*          mode_t mode: permissions if the file is created          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          opens a file the shell keeps for itself. It is moved to  */
+/*          SHELL_FIRST_FD or above, close-on-exec, so "echo >&3"    */
+/*          or "3>file" can never write into it or replace it.       */
+/*                                                                   */
+/*********************************************************************/
+int open_for_shell( const char* path, int flags, mode_t mode )
+{
+    int fd, moved, error;
+
+    if( ( fd = open( path, flags | O_CLOEXEC, mode ) ) == -1 || fd >= SHELL_FIRST_FD )
+        return fd;
+
+    moved = fcntl( fd, F_DUPFD_CLOEXEC, SHELL_FIRST_FD );
+    error = errno;
+    close( fd );
+    errno = error;
+
+    return moved;
+} /* end open_for_shell() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: execute_and_pipe                              */
+/*      Return type:   int - exit status of the last command         */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          pipeline* pl: pipeline of list to run                    */
 /*                                                                   */
 /*      Description:                                                 */
-/*          executes a program entered in the command line by user.  */
+/*          starts every command of the pipeline, connected by       */
+/*          pipes, then waits for all of them. They all run at the   */
+/*          same time, so a command can write more than a pipe holds */
+/*          while the next one reads it. Each pipe is created just   */
+/*          before the command writing to it, so however long the    */
+/*          pipeline, the shell holds at most 3 of their ends. With  */
+/*          "set pipesize=", or "pipesize=SIZE" in front of the      */
+/*          first command, every pipe is made to hold SIZE bytes.    */
 /*                                                                   */
 /*********************************************************************/
-void execute( const int infile, const int outfile, int n_pipes, int pipe_loc[] )
+static int execute_and_pipe( command_list* list, pipeline* pl )
 {
-    int fd_in, fd_out;
+    command* cmd = &list->commands[pl->first_command];
+    int i, n_pipes = pl->n_commands - 1, pipe_fd[2], fd_in = STDIN_FILENO, fd_out, status;
+    pid_t pids[pl->n_commands];
+    long size;
+
+    if( find_pipe_size( list, pl, &size ) == FAILURE )
+        return 1;
 
-    // attempt to open input file
-    if( infile != -1 )
+    for ( i = 0; i < pl->n_commands; i++ )
     {
-        fd_in = open( cmds[infile], O_RDONLY );
+        // the last command writes to stdout
+        if ( i == n_pipes )
+            fd_out = STDOUT_FILENO;
+        // both ends are close-on-exec, a command only gets the two it
+        // is handed, as its stdin and stdout, and no other stage's
+        else if ( pipe2( pipe_fd, O_CLOEXEC ) == -1 )
+        {
+            fprintf( stderr, "Error: Calling pipe2() failed - %s\n", strerror( errno ) );
 
-        // set redirect marker to NULL for execvp()
-        free( cmds[infile - 1] );
-        cmds[infile - 1] = NULL;
+            // generate_process() closed every other end already
+            if ( fd_in != STDIN_FILENO )
+                close( fd_in );
+            break;
+        }
+        else
+        {
+            // a size the kernel refuses leaves the pipe as it was, the
+            // rest of the pipeline is not resized either
+            if( size > 0 && fcntl( pipe_fd[WRITE_END], F_SETPIPE_SZ, (int)size ) == -1 )
+            {
+                fprintf( stderr, "Error: could not make a pipe hold %ld bytes - %s\n", size, strerror( errno ) );
+                size = 0;
+            }
+            fd_out = pipe_fd[WRITE_END];
+        }
+
+        // execute command, the process redirects input from read end of previous pipe
+        // and redirects output to write end of current pipe. generate_process()
+        // closes both in the shell, which only keeps the read end of the newest
+        // pipe until the next command is started
+        pids[i] = generate_process( fd_in, fd_out, list, &cmd[i] );
+        fd_in = pipe_fd[READ_END];
     }
-    else
-        fd_in = STDIN_FILENO;
 
-    // error handling for input file
-    if( fd_in == -1 )
+    // the commands already started still have to be waited for
+    status = wait_for_processes( pids, i );
+    return ( i < pl->n_commands ? 1 : status );
+} /* end execute_and_pipe */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_pipe_size                                */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          pipeline* pl: pipeline about to run                      */
+/*          long* size: set to the bytes a pipe should hold, 0 for   */
+/*                      the system's default                         */
+/*                                                                   */
+/*      Description:                                                 */
+/*          the pipe size is "set pipesize=" unless pl starts with   */
+/*          "pipesize=SIZE". Without privileges no pipe can hold     */
+/*          more than pipe-max-size, so the size is capped there.    */
+/*                                                                   */
+/*********************************************************************/
+static int find_pipe_size( command_list* list, pipeline* pl, long* size )
+{
+    char buffer[32];
+    long max;
+    int fd;
+    ssize_t n;
+
+    *size = get_option( OPTION_PIPESIZE );
+
+    if( pl->size_word != -1 &&
+        read_option( OPTION_PIPESIZE, list->words->words[pl->size_word] + strlen( PIPE_SIZE_PREFIX ), size ) == FAILURE )
+        return FAILURE;
+
+    if( *size == 0 || ( fd = open( PIPE_MAX_SIZE_FILE, O_RDONLY | O_CLOEXEC ) ) == -1 )
+        return SUCCESS;
+
+    n = read( fd, buffer, sizeof(buffer) - 1 );
+    close( fd );
+
+    if( n > 0 )
     {
-        fprintf( stderr, "Error: cannot open input file %s\n", cmds[infile] ); 
-        return;
+        buffer[n] = '\0';
+        if( ( max = strtol( buffer, NULL, 10 ) ) > 0 && *size > max )
+            *size = max;
     }
 
-    // attempt to open output file
-    if( outfile != -1 )
+    return SUCCESS;
+} /* end find_pipe_size() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: execute_builtin                               */
+/*      Return type:   int - exit status of the builtin              */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: builtin to run                             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          runs a builtin in the shell process. Its redirects are   */
+/*          applied to the shell's own descriptors and undone        */
+/*          afterwards. Without a program, the assignments of cmd    */
+/*          are made instead, and the status is that of the last     */
+/*          command substitution in them, as in "x=$(false)".        */
+/*                                                                   */
+/*********************************************************************/
+static int execute_builtin( command_list* list, command* cmd )
+{
+    arguments* args = &list->expanded[cmd - list->commands];
+    int i, fd, failed, status = 1, * saved;
+
+    if( args->argc == 0 && cmd->n_redirects == 0 )
+        return ( assign_variables( list, cmd ) == SUCCESS ? substitution_status : 1 );
+
+    if( cmd->n_redirects == 0 )
+        return run_builtin( cmd->builtin, args->argc, args->argv, stdout );
+
+    if( ( saved = (int*)arena_alloc( &line_arena, cmd->n_redirects * sizeof(int) ) ) == NULL )
     {
-        fd_out = open( cmds[outfile], O_RDWR | O_CREAT, 0666 );
+        fprintf( stderr, "Error: could not allocate memory for redirects\n" );
+        return 1;
+    }
 
-        // set redirect marker to NULL for execvp()
-        free( cmds[outfile - 1] );
-        cmds[outfile - 1] = NULL; 
+    // the descriptors from SHELL_FIRST_FD up are the shell's own
+    for( i = 0; i < cmd->n_redirects; i++ )
+    {
+        if( list->redirects[cmd->first_redirect + i].fd >= SHELL_FIRST_FD )
+        {
+            fprintf( stderr, "Error: descriptor %d is used by the shell\n", list->redirects[cmd->first_redirect + i].fd );
+            return 1;
+        }
     }
-    else
-        fd_out = STDOUT_FILENO;
 
-    // error handling for output file
-    if( fd_out == -1 )
+    // keep a copy of every descriptor we are about to replace
+    for( i = 0; i < cmd->n_redirects; i++ )
+        saved[i] = fcntl( list->redirects[cmd->first_redirect + i].fd, F_DUPFD_CLOEXEC, SHELL_FIRST_FD );
+
+    fflush( stdout );
+    if( apply_redirects( list, cmd, &failed ) == SUCCESS )
     {
-        fprintf( stderr, "Error: can't open output file %s\n", cmds[outfile] );
-        return;
+        if( args->argc == 0 )
+            status = ( assign_variables( list, cmd ) == SUCCESS ? substitution_status : 1 );
+        else
+            status = run_builtin( cmd->builtin, args->argc, args->argv, stdout );
     }
-    
-    // handle pipelines if needed, or spawn process and execute prog 
-    if( n_pipes > 0 )
-        execute_and_pipe( n_pipes, pipe_loc, fd_in, fd_out );
     else
-        generate_process( fd_in, fd_out, cmds );
+        report_redirect( list, &list->redirects[cmd->first_redirect + failed] );
+    fflush( stdout );
+    fflush( stderr );
 
-    return;
+    // put the descriptors back, last one replaced first
+    for( i = cmd->n_redirects - 1; i >= 0; i-- )
+    {
+        fd = list->redirects[cmd->first_redirect + i].fd;
 
-}/* end execute() */
+        if( saved[i] == -1 )
+            close( fd );
+        else
+        {
+            dup2( saved[i], fd );
+            close( saved[i] );
+        }
+    }
+
+    return status;
+} /* end execute_builtin() */
 
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: execute_and_pipe                              */
-/*      Return type:   void                                          */
+/*      Function name: generate_process                              */
+/*      Return type:   pid_t - process started, -1 on failure        */
 /*      Parameter(s):                                                */
-/*          int n_pipes: number of pipes entered in command line.    */
+/*          int fd_in: descriptor the command reads from             */
+/*          int fd_out: descriptor the command writes to             */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: command to run                             */
 /*                                                                   */
 /*      Description:                                                 */
-/*          executes a program entered in the command line by user   */
-/*          and creates pipelines through the programs.              */
+/*          creates a process and executes a program, or a builtin   */
+/*          when it is part of a pipeline. fd_in and fd_out are      */
+/*          closed in the shell either way, the caller waits for the */
+/*          process with wait_for_processes().                       */
 /*                                                                   */
 /*********************************************************************/
-static void execute_and_pipe( int n_pipes, int pipe_loc[], int fd_in, int fd_out )
+static pid_t generate_process( int fd_in, int fd_out, command_list* list, command* cmd )
 {
-    char** current_cmd = cmds;
-    int i, j, pipe_fd[n_pipes][2];
+    pid_t pid = -1, pgid = getpgrp();
+    long method = get_option( OPTION_SPAWN );
+    arguments* args = &list->expanded[cmd - list->commands];
+    char** prog = args->argv, ** envp = NULL, * path = NULL;
 
-    // create first pipeline
-    if ( pipe( pipe_fd[0] ) == -1 )
+    // find the program and build its environment before forking,
+    // so the child only has to exec; no environment counts as an
+    // allocation failure
+    if( cmd->builtin == BUILTIN_NONE && args->argc > 0 )
     {
-        fprintf( stderr, "Error: Calling pipe() failed.\n" );
-        return;
-    } // pipe has been created 
+        if( ( envp = build_envp( list, cmd ) ) == NULL )
+            prog = NULL;
+        else
+            path = find_program( prog[0] );
+    }
 
-    /* process programs */
-    for ( i = 0; i < n_pipes; i++ )
+    // a builtin needs the shell's code in the child, and a program
+    // not found still has its redirects made, "> out" creates out
+    if( path == NULL )
+        method = SPAWN_FORK;
+
+    // anything still buffered would be written again by the child
+    fflush( stdout );
+
+    if( prog != NULL )
     {
-        // set index of pipe to null so execvp knows where to stop 
-        free( cmds[pipe_loc[i]] );
-        cmds[pipe_loc[i]] = NULL;
+        if( method == SPAWN_POSIX )
+            pid = spawn_program( fd_in, fd_out, list, cmd, path, envp );
+        else
+            pid = fork_program( fd_in, fd_out, list, cmd, path, envp, method );
+    }
+
+    // close descriptors if necessary in parent
+    if ( fd_in != STDIN_FILENO )
+        close( fd_in );
+
+    if ( fd_out != STDOUT_FILENO )
+        close( fd_out );
+
+    // set process group ID if it does not match process ID
+    if( pid > 0 && pid != pgid )
+        setpgid( pid, pgid );
+
+    return pid;
+} /* end generate_process */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: wait_for_processes                            */
+/*      Return type:   int - exit status of the pipeline             */
+/*      Parameter(s):                                                */
+/*          pid_t* pids: processes of the pipeline, -1 for a command */
+/*                       that could not be started                   */
+/*          int n: number of processes                               */
+/*                                                                   */
+/*      Description:                                                 */
+/*          waits for every process of a pipeline. Its status is the */
+/*          status of the last command or, with "set pipefail=on",   */
+/*          of the last command that failed.                         */
+/*                                                                   */
+/*********************************************************************/
+static int wait_for_processes( pid_t* pids, int n )
+{
+    int i, raw, status, result = 0, pipefail = ( get_option( OPTION_PIPEFAIL ) == T );
+    pid_t w;
+    void (*istat)(int), (*qstat)(int);
 
-        // first cmd running  
-        if ( i == 0 )
+    // ignore ctrl-c & ctrl-\ while we wait for child process to finish
+    // this is so if we try to quit a program we are running (child process)
+    // we don't completely exit the shell
+    istat = signal(SIGINT, SIG_IGN);
+    qstat = signal(SIGQUIT, SIG_IGN);
+
+    for( i = 0; i < n; i++ )
+    {
+        // a command that could not be started or waited for failed
+        status = 1;
+        if( pids[i] > 0 )
         {
-            // execute command, this process redirects output to write end of current pipe
-            generate_process( fd_in, pipe_fd[i][WRITE_END], current_cmd );
+            while( ( w = waitpid( pids[i], &raw, 0 ) ) == -1 && errno == EINTR )
+                continue;
+            if( w != -1 )
+                status = ( WIFEXITED( raw ) ? WEXITSTATUS( raw ) : 128 + WTERMSIG( raw ) );
         }
+
+        if( !pipefail || status != 0 )
+            result = status;
+    }
+
+    // allow for ctrl-c & ctrl-\ now that we are done with child process
+    signal(SIGINT, istat);
+    signal(SIGQUIT, qstat);
+
+    return result;
+} /* end wait_for_processes() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: fork_program                                  */
+/*      Return type:   pid_t - the child, -1 if it did not start     */
+/*      Parameter(s):                                                */
+/*          int fd_in: descriptor the command reads from             */
+/*          int fd_out: descriptor the command writes to             */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: command to run                             */
+/*          char* path: program found in $PATH, NULL if none         */
+/*          char** envp: environment of the program                  */
+/*          long method: SPAWN_FORK or SPAWN_VFORK                   */
+/*                                                                   */
+/*      Description:                                                 */
+/*          starts the command in a child of fork() or vfork(), and  */
+/*          waits for it to exec through a close-on-exec pipe. When  */
+/*          it cannot, it writes a child_error to the pipe instead,  */
+/*          and the error is printed here, where stdio is safe.      */
+/*                                                                   */
+/*********************************************************************/
+static pid_t fork_program( int fd_in, int fd_out, command_list* list, command* cmd,
+                           char* path, char** envp, long method )
+{
+    child_error report;
+    int report_fd[2], moved;
+    ssize_t n;
+    pid_t pid;
+
+    if( pipe2( report_fd, O_CLOEXEC ) == -1 )
+    {
+        fprintf( stderr, "Error: Calling pipe2() failed - %s\n", strerror( errno ) );
+        return -1;
+    }
+
+    // kept out of the way of the descriptors the command names
+    if( ( moved = fcntl( report_fd[WRITE_END], F_DUPFD_CLOEXEC, SHELL_FIRST_FD ) ) != -1 )
+    {
+        close( report_fd[WRITE_END] );
+        report_fd[WRITE_END] = moved;
+    }
+
+    // the vfork() child borrows our memory until it execs
+    if( ( pid = ( method == SPAWN_VFORK ? vfork() : fork() ) ) == 0 )
+        run_child( fd_in, fd_out, list, cmd, path, envp, report_fd[WRITE_END] );
+
+    close( report_fd[WRITE_END] );
+
+    if( pid < 0 )
+    {
+        fprintf( stderr, "Error: could not fork() in generate_process()\n" );
+        close( report_fd[READ_END] );
+        return -1;
+    }
+
+    // nothing comes through when the command started
+    while( ( n = read( report_fd[READ_END], &report, sizeof(report) ) ) == -1 && errno == EINTR )
+        continue;
+    close( report_fd[READ_END] );
+
+    if( n == (ssize_t)sizeof(report) )
+    {
+        if( report.redirect >= 0 )
+            report_redirect( list, &list->redirects[cmd->first_redirect + report.redirect] );
         else
+            report_not_run( list->expanded[cmd - list->commands].argv[0], report.error );
+    }
+
+    return pid;
+} /* end fork_program() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: run_child                                     */
+/*      Return type:   void - never returns                          */
+/*      Parameter(s):                                                */
+/*          int fd_in: descriptor the command reads from             */
+/*          int fd_out: descriptor the command writes to             */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: command to run                             */
+/*          char* path: program found in $PATH, NULL if none         */
+/*          char** envp: environment of the program                  */
+/*          int report_fd: where to write a child_error              */
+/*                                                                   */
+/*      Description:                                                 */
+/*          the child of fork() or vfork(): sets up its descriptors  */
+/*          and execs the program, or runs the builtin. The shell    */
+/*          has threads, and after vfork() the child shares its      */
+/*          memory, so until it execs it only makes calls that are   */
+/*          async-signal-safe and leaves through _exit(). A builtin, */
+/*          which is always forked, is the exception: it closes      */
+/*          report_fd, so the shell goes on, and runs as usual.      */
+/*                                                                   */
+/*********************************************************************/
+static void run_child( int fd_in, int fd_out, command_list* list, command* cmd,
+                       char* path, char** envp, int report_fd )
+{
+    arguments* args = &list->expanded[cmd - list->commands];
+    child_error report = { -1, ENOENT };
+
+    // if we are not directing to stdout, reassign output
+    if ( fd_out != STDOUT_FILENO )
+    {
+        dup2( fd_out, STDOUT_FILENO );
+        close( fd_out );
+    }
+
+    // if we are not getting from stdin, reassign input
+    if ( fd_in != STDIN_FILENO )
+    {
+        dup2( fd_in, STDIN_FILENO );
+        close( fd_in );
+    }
+
+    // redirects of the command win over the pipes
+    if( apply_redirects( list, cmd, &report.redirect ) == FAILURE )
+    {
+        report.error = errno;
+        fail_child( report_fd, &report );
+    }
+
+    // builtin inside a pipeline
+    if( cmd->builtin != BUILTIN_NONE )
+    {
+        close( report_fd );
+        exit( run_builtin( cmd->builtin, args->argc, args->argv, stdout ) );
+    }
+
+    // nothing to run, e.g. "> file"
+    if( args->argc == 0 )
+        _exit(0);
+
+    // the child must never return into the shell's code, or every
+    // failed program would leave one more shell to exit
+    if( path != NULL )
+    {
+        execve( path, args->argv, envp );
+
+        // a script without #! is run by sh, as execvp() would
+        if( ( report.error = errno ) == ENOEXEC )
+        {
+            exec_script( path, args->argc, args->argv, envp );
+            report.error = errno;
+        }
+    }
+
+    fail_child( report_fd, &report );
+} /* end run_child() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: fail_child                                    */
+/*      Return type:   void - never returns                          */
+/*      Parameter(s):                                                */
+/*          int report_fd: pipe to the shell                         */
+/*          child_error* report: why the command could not run       */
+/*                                                                   */
+/*      Description:                                                 */
+/*          hands report to the shell and exits with status 1.       */
+/*                                                                   */
+/*********************************************************************/
+static void fail_child( int report_fd, child_error* report )
+{
+    ssize_t written;
+
+    // nothing more can be done if this fails, the status still tells
+    written = write( report_fd, report, sizeof(*report) );
+    (void)written;
+
+    _exit(1);
+} /* end fail_child() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: spawn_program                                 */
+/*      Return type:   pid_t - the child, -1 if it did not start     */
+/*      Parameter(s):                                                */
+/*          int fd_in: descriptor the command reads from             */
+/*          int fd_out: descriptor the command writes to             */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: command to run                             */
+/*          char* path: program found in $PATH                       */
+/*          char** envp: environment of the program                  */
+/*                                                                   */
+/*      Description:                                                 */
+/*          starts path with posix_spawn(), which never copies the   */
+/*          shell's page tables. The pipes and redirects become      */
+/*          file actions; files are opened here, close-on-exec, so   */
+/*          a missing one is reported as the child would.            */
+/*                                                                   */
+/*********************************************************************/
+static pid_t spawn_program( int fd_in, int fd_out, command_list* list, command* cmd,
+                            char* path, char** envp )
+{
+    posix_spawn_file_actions_t actions;
+    arguments* args = &list->expanded[cmd - list->commands];
+    redirect* r;
+    pid_t pid = -1;
+    int i, fd, error = 0, n_closed = 0, n_ends, closed[2 * cmd->n_redirects + 3];
+    char* sh_argv[args->argc + 2];
+
+    if( posix_spawn_file_actions_init( &actions ) != 0 )
+    {
+        fprintf( stderr, "Error: could not allocate memory to start %s\n", args->argv[0] );
+        return -1;
+    }
+
+    // the pipe ends are closed in the child once they are moved,
+    // before any redirect could copy them, then come the files
+    // opened for the child
+    if( fd_out != STDOUT_FILENO )
+        closed[n_closed++] = fd_out;
+    if( fd_in != STDIN_FILENO )
+        closed[n_closed++] = fd_in;
+    n_ends = n_closed;
+
+    // the same steps as run_child(), in the same order
+    if( fd_out != STDOUT_FILENO )
+    {
+        error |= posix_spawn_file_actions_adddup2( &actions, fd_out, STDOUT_FILENO );
+        error |= posix_spawn_file_actions_addclose( &actions, fd_out );
+    }
+    if( fd_in != STDIN_FILENO )
+    {
+        error |= posix_spawn_file_actions_adddup2( &actions, fd_in, STDIN_FILENO );
+        error |= posix_spawn_file_actions_addclose( &actions, fd_in );
+    }
+
+    for( i = 0; i < cmd->n_redirects && error == 0; i++ )
+    {
+        r = &list->redirects[cmd->first_redirect + i];
+
+        if( r->type == TOKEN_DUP_IN || r->type == TOKEN_DUP_OUT )
         {
-            // create another pipeline
-            if ( pipe( pipe_fd[i] ) == -1 )
+            // the target is checked here, the child could only fail
+            if( !has_descriptor( list, cmd, i, r->target, closed, n_closed ) )
             {
-                fprintf( stderr, "Error: Calling pipe() failed.\n" );
-                
-                // close all pipes we've created
-                for( j = 0; j < i; j++ )
-                {
-                    close( pipe_fd[j][READ_END] );
-                    close( pipe_fd[j][WRITE_END] );
-                }
-                return;
-            } // pipe has been created
-
-            // execute command, this time the process redirects input from read end of previous pipe
-            // and redirects output to write end of current pipe
-            generate_process( pipe_fd[i-1][READ_END], pipe_fd[i][WRITE_END], current_cmd );
+                report_redirect( list, r );
+                break;
+            }
+            error = posix_spawn_file_actions_adddup2( &actions, r->target, r->fd );
+            continue;
+        }
+
+        if( ( fd = open_redirect( r, list->words->words[r->target], O_CLOEXEC ) ) == -1 )
+        {
+            report_redirect( list, r );
+            break;
         }
 
-        // adjust current_cmd to point to next set of cmds 
-        current_cmd = &cmds[pipe_loc[i] + 1];
+        // kept out of the way of the descriptors the command
+        // names, dup2() onto itself would leave close-on-exec set
+        closed[n_closed++] = fd;
+        if( fd < SHELL_FIRST_FD && ( fd = fcntl( fd, F_DUPFD_CLOEXEC, SHELL_FIRST_FD ) ) != -1 )
+            closed[n_closed++] = fd;
+
+        error = posix_spawn_file_actions_adddup2( &actions, fd, r->fd );
     }
 
-    // run final command, this will write to stdout and read from read end of previous pipe
-    generate_process( pipe_fd[i-1][READ_END], fd_out, current_cmd );
+    if( i == cmd->n_redirects && error == 0 )
+    {
+        error = posix_spawn( &pid, path, &actions, NULL, args->argv, envp );
+
+        // a script without #! is run by sh, as execvp() would
+        if( error == ENOEXEC )
+        {
+            sh_argv[0] = "sh";
+            sh_argv[1] = path;
+            memcpy( &sh_argv[2], &args->argv[1], args->argc * sizeof(char*) );
+            error = posix_spawn( &pid, "/bin/sh", &actions, NULL, sh_argv, envp );
+        }
 
-    // close all pipes we created
-    for ( i = 0 ; i < n_pipes; i++ )
+        if( error != 0 )
+            report_not_run( args->argv[0], error );
+    }
+    else if( error != 0 )
+        fprintf( stderr, "Error: could not allocate memory to start %s\n", args->argv[0] );
+
+    posix_spawn_file_actions_destroy( &actions );
+    for( i = n_ends; i < n_closed; i++ )
+        close( closed[i] );
+
+    return ( error == 0 ? pid : -1 );
+} /* end spawn_program() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: has_descriptor                                */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: command being spawned                      */
+/*          int n: number of its redirects before this one           */
+/*          int fd: descriptor a >&fd or <&fd redirect copies        */
+/*          int* closed: descriptors of the shell the child will not */
+/*                       have, the pipe ends it was handed and those */
+/*                       opened for its redirects                    */
+/*          int n_closed: number of them                             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          tells if the child will have fd when the redirect is     */
+/*          made: an earlier redirect set it up, or the shell has it */
+/*          and the child does not close it first. The shell's own   */
+/*          descriptors, from SHELL_FIRST_FD up, are never handed    */
+/*          out.                                                     */
+/*                                                                   */
+/*********************************************************************/
+static int has_descriptor( command_list* list, command* cmd, int n, int fd,
+                           int* closed, int n_closed )
+{
+    int i;
+
+    if( set_by_redirect( list, cmd, n, fd ) )
+        return T;
+
+    if( fd >= SHELL_FIRST_FD )
+        return F;
+
+    for( i = 0; i < n_closed; i++ )
     {
-        close( pipe_fd[i][READ_END] );
-        close( pipe_fd[i][WRITE_END] );
+        if( closed[i] == fd )
+            return F;
     }
 
-    return;
-} /* end execute_and_pipe */
+    return ( fcntl( fd, F_GETFD ) != -1 );
+} /* end has_descriptor() */
 
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: generate_process                              */
-/*      Return type:   void                                          */
-/*      Parameter(s):  None                                          */
+/*      Function name: set_by_redirect                               */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: command being run                          */
+/*          int n: number of its redirects to look at                */
+/*          int fd: descriptor looked for                            */
 /*                                                                   */
 /*      Description:                                                 */
-/*          creates a process and executes a program.                */
+/*          tells if one of the first n redirects of cmd is made on  */
+/*          fd, as 12 is in "12> file >&12".                         */
 /*                                                                   */
 /*********************************************************************/
-static int generate_process( int fd_in, int fd_out, char* prog[] )
+static int set_by_redirect( command_list* list, command* cmd, int n, int fd )
 {
-    pid_t pid, pgid = getpgrp();
-    int status, w;
-    void (*istat)(int), (*qstat)(int);
+    int i;
 
-    // if in child process 
-    if( ( pid = fork() ) == 0 )
+    for( i = 0; i < n; i++ )
     {
-        // if we are not directing to stdout, reassign output
-        if ( fd_out != STDOUT_FILENO )
+        if( list->redirects[cmd->first_redirect + i].fd == fd )
+            return T;
+    }
+
+    return F;
+} /* end set_by_redirect() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: apply_redirects                               */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: command whose redirects we apply           */
+/*          int* failed: set to the index of the redirect that       */
+/*                       failed, with errno set                      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          opens every file cmd redirects to and places it on the   */
+/*          descriptor being redirected, left to right, so           */
+/*          "> out 2>&1" sends both to out. Prints nothing, so the   */
+/*          child of vfork() can call it; see report_redirect().     */
+/*                                                                   */
+/*********************************************************************/
+static int apply_redirects( command_list* list, command* cmd, int* failed )
+{
+    redirect* r;
+    int i, fd;
+
+    for( i = 0; i < cmd->n_redirects; i++ )
+    {
+        r = &list->redirects[cmd->first_redirect + i];
+
+        // >&N and <&N copy a descriptor we already have, but not
+        // one the shell keeps for itself
+        if( r->type == TOKEN_DUP_IN || r->type == TOKEN_DUP_OUT )
         {
-            dup2( fd_out, STDOUT_FILENO );
-            close( fd_out );
+            if( r->target >= SHELL_FIRST_FD && !set_by_redirect( list, cmd, i, r->target ) )
+            {
+                errno = EBADF;
+                *failed = i;
+                return FAILURE;
+            }
+            if( dup2( r->target, r->fd ) == -1 )
+            {
+                *failed = i;
+                return FAILURE;
+            }
+            continue;
         }
 
-        // if we are not getting from stdin, reassign input 
-        if ( fd_in != STDIN_FILENO )
+        if( ( fd = open_redirect( r, list->words->words[r->target], 0 ) ) == -1 )
         {
-            dup2( fd_in, STDIN_FILENO );
-            close( fd_in );
+            *failed = i;
+            return FAILURE;
         }
 
-        // execute command
-        // in the event of the command execution failing, we need to exit(1)
-        // this is because execvp essentially clones the parent process into a 
-        // new shell to run the program, and if we don't exit on failure,
-        // we will need to "exit" the shell as many times as child processes created.
-        if( execvp( prog[0], prog ) == -1 )
+        if( fd != r->fd )
         {
-            fprintf( stderr, "Error: cannot run the program '%s'\n", prog[0] );
-            fprintf( stderr, "       this may be because the program is not in $PATH or\n" );
-            fprintf( stderr, "       there is not an alias specified for this command, among other possibilities\n" );
-            exit(1);
+            dup2( fd, r->fd );
+            close( fd );
         }
     }
-    else if( pid < 0 ) // fork error
+
+    return SUCCESS;
+} /* end apply_redirects() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: open_redirect                                 */
+/*      Return type:   int - the descriptor, -1 on failure           */
+/*      Parameter(s):                                                */
+/*          redirect* r: <, > or >> redirect                         */
+/*          const char* file: file it names                          */
+/*          int flags: added to the flags of the redirect            */
+/*                                                                   */
+/*      Description:                                                 */
+/*          opens the file of a redirect. The error, when it cannot  */
+/*          be opened, is left to report_redirect().                 */
+/*                                                                   */
+/*********************************************************************/
+static int open_redirect( redirect* r, const char* file, int flags )
+{
+    int fd;
+
+    // attempt to open file
+    if( r->type == TOKEN_REDIRECT_IN )
+        fd = open( file, O_RDONLY | flags );
+    else if( r->type == TOKEN_APPEND )
+        fd = open( file, O_WRONLY | O_CREAT | O_APPEND | flags, 0666 );
+    else
+        fd = open( file, O_WRONLY | O_CREAT | O_TRUNC | flags, 0666 );
+
+    return fd;
+} /* end open_redirect() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: assign_variables                              */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: command whose assignments we make          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          sets the shell variable of every "NAME=value" word in    */
+/*          front of cmd. The words have already been expanded.      */
+/*                                                                   */
+/*********************************************************************/
+static int assign_variables( command_list* list, command* cmd )
+{
+    char* word, * equals;
+    int i;
+
+    for( i = 0; i < cmd->n_assigns; i++ )
+    {
+        word = list->words->words[list->args[cmd->first_assign + i]];
+        equals = strchr( word, '=' );
+
+        if( set_variable( word, (size_t)( equals - word ), equals + 1, VAR_KEEP ) == FAILURE )
+            return FAILURE;
+    }
+
+    return SUCCESS;
+} /* end assign_variables() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: build_envp                                    */
+/*      Return type:   char** - NULL on failure                      */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          command* cmd: command about to be run                    */
+/*                                                                   */
+/*      Description:                                                 */
+/*          environment for cmd. Usually the shared one, for         */
+/*          "NAME=value prog" an overlay with the assignments.       */
+/*                                                                   */
+/*********************************************************************/
+static char** build_envp( command_list* list, command* cmd )
+{
+    char** assigns;
+    int i;
+
+    if( cmd->n_assigns == 0 )
+        return get_environment();
+
+    if( ( assigns = (char**)arena_alloc( &line_arena, cmd->n_assigns * sizeof(char*) ) ) == NULL )
     {
-        fprintf( stderr, "Error: could not fork() in generate_process()\n" );
-        return FAILURE;
-    } // parent process 
+        fprintf( stderr, "Error: could not allocate memory for the environment\n" );
+        return NULL;
+    }
 
-    // set process group ID if it does not match process ID
-    if( pid != pgid )
-        setpgid( pid, pgid );
+    for( i = 0; i < cmd->n_assigns; i++ )
+        assigns[i] = list->words->words[list->args[cmd->first_assign + i]];
 
-    // ignore ctrl-c & ctrl-\ while we wait for child process to finish
-    // this is so if we try to quit a program we are running (child process)
-    // we don't completely exit the shell
-    istat = signal(SIGINT, SIG_IGN);
-    qstat = signal(SIGQUIT, SIG_IGN);
+    return overlay_environment( assigns, cmd->n_assigns );
+} /* end build_envp() */
 
-    // close descriptors if necessary in parent 
-    if ( fd_in != STDIN_FILENO )
-        close( fd_in );
 
-    if ( fd_out != STDOUT_FILENO )
-        close( fd_out );
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_program                                  */
+/*      Return type:   char* - path of the program, NULL if none     */
+/*      Parameter(s):                                                */
+/*          const char* name: program name, argv[0]                  */
+/*                                                                   */
+/*      Description:                                                 */
+/*          looks name up in $PATH, through the table of programs    */
+/*          already found, so only the first run searches. A name    */
+/*          with a '/' in it is used as it is.                       */
+/*                                                                   */
+/*********************************************************************/
+static char* find_program( const char* name )
+{
+    const char* path;
 
-    // wait for child processes to finish
-    while( ( w = wait( &status ) ) != pid && w != -1 )
-        continue;
+    if( strchr( name, '/' ) != NULL )
+        return (char*)name;
 
-    // allow for ctrl-c & ctrl-\ now that we are done with child process
-    signal(SIGINT, istat);
-    signal(SIGQUIT, qstat);
+    if( ( path = find_in_path( name ) ) == NULL )
+        return NULL;
 
-    return pid;
-} /* end generate_process */
+    return arena_strdup( &line_arena, path );
+} /* end find_program() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: exec_script                                   */
+/*      Return type:   void - only returns if sh cannot be run       */
+/*      Parameter(s):                                                */
+/*          const char* path: script that execve() refused           */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the script                     */
+/*          char** envp: environment of the script                   */
+/*                                                                   */
+/*      Description:                                                 */
+/*          runs "sh path args...". Only called in the child, which  */
+/*          may share the shell's memory, so nothing is allocated.   */
+/*                                                                   */
+/*********************************************************************/
+static void exec_script( const char* path, int argc, char** argv, char** envp )
+{
+    char* sh_argv[argc + 2];
+
+    sh_argv[0] = "sh";
+    sh_argv[1] = (char*)path;
+    memcpy( &sh_argv[2], &argv[1], argc * sizeof(char*) );
+
+    execve( "/bin/sh", sh_argv, envp );
+} /* end exec_script() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: report_redirect                               */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          redirect* r: redirect that could not be made             */
+/*                                                                   */
+/*********************************************************************/
+static void report_redirect( command_list* list, redirect* r )
+{
+    if( r->type == TOKEN_DUP_IN || r->type == TOKEN_DUP_OUT )
+        fprintf( stderr, "Error: bad file descriptor %d\n", r->target );
+    else if( r->type == TOKEN_REDIRECT_IN )
+        fprintf( stderr, "Error: cannot open input file %s\n", list->words->words[r->target] );
+    else
+        fprintf( stderr, "Error: can't open output file %s\n", list->words->words[r->target] );
+} /* end report_redirect() */
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: report_not_run                                */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          const char* name: program that could not be run          */
+/*          int error: errno of the exec                             */
+/*                                                                   */
+/*********************************************************************/
+static void report_not_run( const char* name, int error )
+{
+    // the program is there but could not be run
+    if( error != ENOENT )
+    {
+        fprintf( stderr, "Error: cannot run the program '%s' - %s\n", name, strerror( error ) );
+        return;
+    }
+
+    fprintf( stderr, "Error: cannot run the program '%s'\n", name );
+    fprintf( stderr, "       this may be because the program is not in $PATH or\n" );
+    fprintf( stderr, "       there is not an alias specified for this command, among other possibilities\n" );
+} /* end report_not_run() */
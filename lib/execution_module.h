@@ -3,6 +3,9 @@
 /*          Module name: execution_module.h                          */
 /*          Description:                                             */
 /*              This module provides functions to execute programs.  */
+/*              Programs are started with posix_spawn(), vfork() or  */
+/*              fork(), as "set spawn=" says. A builtin in a         */
+/*              pipeline always forks, it runs the shell's code.     */
 /*                                                                   */
 /*********************************************************************/
 
@@ -10,6 +13,9 @@
 #define EXECUTION_MODULE_H
 
 /* directives */
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE     /* pipe2() and F_SETPIPE_SZ */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/wait.h>
@@ -18,7 +24,15 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <spawn.h>
 #include "./string_module.h"
+#include "./parse_module.h"
+#include "./option_module.h"
+#include "./path_module.h"
+#include "./expansion_module.h"
 
 /* macros */
 #ifndef FAILURE
@@ -30,12 +44,28 @@
 
 #define READ_END 0
 #define WRITE_END 1
+#define SHELL_FIRST_FD 10   /* the shell's own descriptors are    */
+                            /* kept at or above this, where no    */
+                            /* redirect can reach them            */
+#define PIPE_MAX_SIZE_FILE "/proc/sys/fs/pipe-max-size"
+
+/* why a child of fork() or vfork() could not run its command, */
+/* written to the shell, which prints it                       */
+typedef struct child_error_t
+{
+    int     redirect;       /* index of the redirect that failed,   */
+                            /* -1 when the program could not run    */
+    int     error;          /* errno                                */
+} child_error;
 
 /* globals */
-extern char* cmds[]; 
-extern int n_cmds;
+extern word_vector cmds;
+
+/* builtins, defined by the shell */
+extern int run_builtin( builtin_id id, int argc, char** argv, FILE* out );
 
 /* standard program execution */
-void    execute( const int infile, const int outfile, int n_pipes, int pipe_loc[] );
+int     execute( command_list* list, pipeline* pl );
+int     open_for_shell( const char* path, int flags, mode_t mode );
 
 #endif
@@ -0,0 +1,784 @@
+#include "expansion_module.h"
+#include "substitution_module.h"
+
+/* globals */
+int substitution_status = 0;
+static expand_buffer    buffer = { NULL, 0, 0 };
+static char             number[24];     /* $?, ${#VAR} and $(( )) */
+static word_vector      fields = { NULL, NULL, 0, 0 };  /* argv being built */
+
+/* static function prototypes */
+static int             expand_text( const char* word, word_vector* out );
+static const char*     expand_variable( const char* word, int* pos, size_t* length );
+static const char*     expand_parameter( const char* word, int* pos, size_t* length );
+static const char*     expand_arithmetic( const char* word, int* pos, size_t* length );
+static const char*     trim_value( const char* value, const char* pattern, char op, int longest, size_t* length );
+static char*           expand_nested( const char* text, size_t length );
+static int             is_arithmetic( const char* word, int pos );
+static int             substitute( const char* word, int* pos, word_vector* out, int* quoted );
+static char*           unescape_backticks( const char* text, size_t* length );
+static int             split_append( const char* text, size_t length, word_vector* out, int* quoted );
+static int             push_field( word_vector* out );
+static int             buffer_append( const char* text, size_t length );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: expand_pipeline                               */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed command line                  */
+/*          pipeline* pl: pipeline about to run                      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          expands the pipe size, assignments, arguments and        */
+/*          redirect file names of every command in pl. The pipe     */
+/*          size, assignments and file names replace their pointers  */
+/*          in list->words, the arguments become the argv in         */
+/*          list->expanded, since the output of a command            */
+/*          substitution can turn one word into several.             */
+/*          The words themselves are never written to, since they    */
+/*          may belong to the cache or to an alias.                  */
+/*          substitution_status is set to the exit status of the     */
+/*          last command substitution, 0 when there is none.         */
+/*                                                                   */
+/*********************************************************************/
+int expand_pipeline( command_list* list, pipeline* pl )
+{
+    command* cmd;
+    redirect* r;
+    arguments* args;
+    char** words = list->words->words;
+    int i, j, index;
+
+    if( list->expanded == NULL &&
+        ( list->expanded = (arguments*)arena_alloc( &line_arena, list->n_commands * sizeof(arguments) ) ) == NULL )
+    {
+        fprintf( stderr, "Error: could not allocate memory for arguments\n" );
+        return FAILURE;
+    }
+
+    substitution_status = 0;
+
+    if( pl->size_word != -1 && ( words[pl->size_word] = expand_word( words[pl->size_word] ) ) == NULL )
+        return FAILURE;
+
+    for( i = 0; i < pl->n_commands; i++ )
+    {
+        cmd = &list->commands[pl->first_command + i];
+        args = &list->expanded[pl->first_command + i];
+
+        for( j = 0; j < cmd->n_assigns; j++ )
+        {
+            index = list->args[cmd->first_assign + j];
+            if( ( words[index] = expand_word( words[index] ) ) == NULL )
+                return FAILURE;
+        }
+
+        // words with nothing to expand go in as they are
+        fields.count = 0;
+        for( j = 0; j < cmd->argc; j++ )
+        {
+            index = list->args[cmd->first_arg + j];
+            if( strpbrk( words[index], "$\'\"\\`" ) == NULL ?
+                push_string( words[index], &fields ) == FAILURE :
+                expand_text( words[index], &fields ) == FAILURE )
+                return FAILURE;
+        }
+
+        if( ( args->argv = (char**)arena_alloc( &line_arena, ( fields.count + 1 ) * sizeof(char*) ) ) == NULL )
+        {
+            fprintf( stderr, "Error: could not allocate memory for arguments\n" );
+            return FAILURE;
+        }
+        if( fields.count > 0 )
+            memcpy( args->argv, fields.words, fields.count * sizeof(char*) );
+        args->argv[fields.count] = NULL;
+        args->argc = fields.count;
+
+        // >&N and <&N have no file name
+        for( j = 0; j < cmd->n_redirects; j++ )
+        {
+            r = &list->redirects[cmd->first_redirect + j];
+            if( r->type != TOKEN_DUP_IN && r->type != TOKEN_DUP_OUT &&
+                ( words[r->target] = expand_word( words[r->target] ) ) == NULL )
+                return FAILURE;
+        }
+    }
+
+    return SUCCESS;
+} /* end expand_pipeline() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: expand_word                                   */
+/*      Return type:   char* (NULL on failure)                       */
+/*      Parameter(s):                                                */
+/*          char* word: word as the lexer found it                   */
+/*                                                                   */
+/*      Description:                                                 */
+/*          expands word into a single word, the output of a command */
+/*          substitution is not split.                               */
+/*          A word with nothing to expand is returned itself,        */
+/*          anything else is copied into line_arena.                 */
+/*                                                                   */
+/*********************************************************************/
+char* expand_word( char* word )
+{
+    // nothing to expand or remove, use the word as is
+    if( strpbrk( word, "$\'\"\\`" ) == NULL )
+        return word;
+
+    if( expand_text( word, NULL ) == FAILURE )
+        return NULL;
+
+    return arena_strndup( &line_arena, ( buffer.data == NULL ? "" : buffer.data ), buffer.length );
+} /* end expand_word() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: free_expansion                                */
+/*      Return type:   none                                          */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*********************************************************************/
+void free_expansion( void )
+{
+    free( buffer.data );
+    buffer.data = NULL;
+    buffer.length = buffer.capacity = 0;
+    free_strings( &fields );
+} /* end free_expansion() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: expand_text                                   */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* word: word as the lexer found it             */
+/*          word_vector* out: fields to add the result to, NULL to   */
+/*                            leave a single word in buffer          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          walks word once, copying plain runs of characters,       */
+/*          removing quotes and backslashes and replacing variables  */
+/*          and command substitutions with their values. Text in     */
+/*          single quotes is kept as is, in double quotes a          */
+/*          backslash only escapes $ ` " and \.                      */
+/*          An unset variable expands to nothing. With out, the      */
+/*          output of an unquoted substitution is split at blanks,   */
+/*          and a word that expands to nothing without any quotes    */
+/*          gives no field at all.                                   */
+/*                                                                   */
+/*********************************************************************/
+static int expand_text( const char* word, word_vector* out )
+{
+    const char* text, * end;
+    size_t length;
+    int i = 0, in_double = F, quoted = F;
+
+    buffer.length = 0;
+
+    while( word[i] != '\0' )
+    {
+        text = &word[i];
+        length = 1;
+
+        if( word[i] == '\'' && !in_double )
+        {
+            // everything up to the closing quote is kept as is
+            text = &word[i + 1];
+            if( ( end = strchr( text, '\'' ) ) == NULL )
+                end = text + strlen( text );
+
+            length = (size_t)( end - text );
+            i = (int)( end - word ) + ( *end == '\'' );
+            quoted = T;
+        }
+        else if( word[i] == '\"' )
+        {
+            in_double = !in_double;
+            quoted = T;
+            i++;
+            continue;
+        }
+        else if( word[i] == '\\' )
+        {
+            // a backslash that escapes nothing is kept
+            if( word[i + 1] != '\0' && ( !in_double || strchr( "$`\"\\", word[i + 1] ) != NULL ) )
+                text++;
+            i += ( text == &word[i] ? 1 : 2 );
+        }
+        else if( is_arithmetic( word, i ) )
+        {
+            if( ( text = expand_arithmetic( word, &i, &length ) ) == NULL )
+                return FAILURE;
+        }
+        else if( word[i] == '`' || ( word[i] == '$' && word[i + 1] == '(' ) )
+        {
+            // only output outside double quotes is split
+            if( substitute( word, &i, ( in_double ? NULL : out ), &quoted ) == FAILURE )
+                return FAILURE;
+            continue;
+        }
+        else if( word[i] == '$' )
+        {
+            if( ( text = expand_variable( word, &i, &length ) ) == NULL )
+                return FAILURE;
+        }
+        else
+        {
+            // copy the run of plain characters at once, a ' inside
+            // double quotes is one of them
+            length = 1 + strcspn( text + 1, "$\'\"\\`" );
+            i += (int)length;
+        }
+
+        if( buffer_append( text, length ) == FAILURE )
+            return FAILURE;
+    }
+
+    if( out != NULL && ( buffer.length > 0 || quoted ) )
+        return push_field( out );
+
+    return SUCCESS;
+} /* end expand_text() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: expand_variable                               */
+/*      Return type:   const char* - value, NULL on a bad ${}        */
+/*      Parameter(s):                                                */
+/*          const char* word: word being expanded                    */
+/*          int* pos: index of the '$', moved past the variable      */
+/*          size_t* length: set to the length of the value           */
+/*                                                                   */
+/*      Description:                                                 */
+/*          reads $NAME, ${...} or $? at *pos. A '$' that does not   */
+/*          start a variable is kept, and $0 - $9 expand to nothing  */
+/*          since there are no positional parameters.                */
+/*                                                                   */
+/*********************************************************************/
+static const char* expand_variable( const char* word, int* pos, size_t* length )
+{
+    const char* name = &word[*pos + 1], * value;
+    size_t n;
+
+    // $? is the exit status of the last pipeline
+    if( *name == '?' )
+    {
+        *length = (size_t)snprintf( number, sizeof(number), "%d", last_status );
+        *pos += 2;
+        return number;
+    }
+
+    if( *name == '{' )
+        return expand_parameter( word, pos, length );
+
+    if( ( n = variable_name_length( name ) ) > 0 )
+        *pos += (int)n + 1;
+    else if( isdigit( (unsigned char)name[0] ) )
+    {
+        *pos += 2;
+        *length = 0;
+        return "";
+    }
+    else
+    {
+        // just a '$'
+        *pos += 1;
+        *length = 1;
+        return "$";
+    }
+
+    if( ( value = get_variable_n( name, n ) ) == NULL )
+        value = "";
+
+    *length = strlen( value );
+    return value;
+} /* end expand_variable() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: expand_parameter                              */
+/*      Return type:   const char* - value, NULL on failure          */
+/*      Parameter(s):                                                */
+/*          const char* word: word being expanded                    */
+/*          int* pos: index of the "${", moved past the '}'          */
+/*          size_t* length: set to the length of the value           */
+/*                                                                   */
+/*      Description:                                                 */
+/*          ${NAME}, ${#NAME} for the length of the value, and       */
+/*          ${NAME op word} where op is one of                       */
+/*              -  word if NAME is unset                             */
+/*              =  same, and NAME is set to word                     */
+/*              +  word if NAME is set, nothing otherwise            */
+/*              ?  error if NAME is unset                            */
+/*          With a ':' before the op, empty counts as unset.         */
+/*              # ## the value without the shortest/longest prefix   */
+/*                   that matches the pattern word                   */
+/*              % %% the same with a suffix                          */
+/*          word is only expanded when it is used.                   */
+/*                                                                   */
+/*********************************************************************/
+static const char* expand_parameter( const char* word, int* pos, size_t* length )
+{
+    const char* inner = &word[*pos + 2], * value, * rest;
+    char* operand;
+    size_t n;
+    int end, colon, unset, longest;
+    char op;
+
+    if( ( end = find_substitution_end( word, *pos ) ) == -1 )
+    {
+        fprintf( stderr, "Error: bad substitution - %s\n", word );
+        return NULL;
+    }
+    *pos = end;
+
+    // ${#NAME}
+    if( *inner == '#' && ( n = variable_name_length( inner + 1 ) ) > 0 && inner[n + 1] == '}' )
+    {
+        value = get_variable_n( inner + 1, n );
+        *length = (size_t)snprintf( number, sizeof(number), "%zu", ( value == NULL ? 0 : strlen( value ) ) );
+        return number;
+    }
+
+    rest = inner + ( n = variable_name_length( inner ) );
+    colon = ( *rest == ':' );
+    op = rest[colon];
+
+    if( n == 0 || ( op != '}' && strchr( "-=+?#%", op ) == NULL ) || ( colon && strchr( "-=+?", op ) == NULL ) )
+    {
+        fprintf( stderr, "Error: bad substitution - %s\n", word );
+        return NULL;
+    }
+
+    value = get_variable_n( inner, n );
+    if( op == '}' )
+    {
+        *length = ( value == NULL ? 0 : strlen( value ) );
+        return ( value == NULL ? "" : value );
+    }
+
+    // ## and %% look for the longest match
+    rest += colon + 1;
+    if( ( longest = ( ( op == '#' || op == '%' ) && *rest == op ) ) )
+        rest++;
+
+    unset = ( value == NULL || ( colon && *value == '\0' ) );
+
+    // the value itself is all that is needed
+    if( ( op == '-' || op == '=' || op == '?' ) && !unset )
+    {
+        *length = strlen( value );
+        return value;
+    }
+    if( op == '+' && unset )
+    {
+        *length = 0;
+        return "";
+    }
+
+    if( ( operand = expand_nested( rest, (size_t)( &word[end - 1] - rest ) ) ) == NULL )
+        return NULL;
+
+    switch( op )
+    {
+        case '?':
+            fprintf( stderr, "Error: %.*s: %s\n", (int)n, inner, ( *operand == '\0' ? "parameter not set" : operand ) );
+            return NULL;
+        case '=':
+            if( set_variable( inner, n, operand, VAR_KEEP ) == FAILURE )
+                return NULL;
+            break;
+        case '#':
+        case '%':
+            // get the value again, the pattern may have changed it
+            if( ( value = get_variable_n( inner, n ) ) == NULL )
+                value = "";
+            return trim_value( value, operand, op, longest, length );
+        default:
+            break;
+    }
+
+    *length = strlen( operand );
+    return operand;
+} /* end expand_parameter() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: trim_value                                    */
+/*      Return type:   const char* - what is left of value           */
+/*      Parameter(s):                                                */
+/*          const char* value: value of the variable                 */
+/*          const char* pattern: shell pattern to remove             */
+/*          char op: '#' to remove a prefix, '%' for a suffix        */
+/*          int longest: T to remove the longest match               */
+/*          size_t* length: set to the length of what is left        */
+/*                                                                   */
+/*      Description:                                                 */
+/*          tries the prefixes or suffixes of value from the         */
+/*          shortest or the longest one on, with fnmatch().          */
+/*                                                                   */
+/*********************************************************************/
+static const char* trim_value( const char* value, const char* pattern, char op, int longest, size_t* length )
+{
+    size_t size = strlen( value ), i, cut;
+    char* copy = NULL, saved;
+
+    *length = size;
+
+    // a prefix has to be cut off a copy to be matched
+    if( op == '#' && ( copy = arena_strndup( &line_arena, value, size ) ) == NULL )
+        return NULL;
+
+    for( i = 0; i <= size; i++ )
+    {
+        // cut is the length of the prefix or suffix being tried
+        cut = ( longest ? size - i : i );
+
+        if( op == '%' )
+        {
+            if( fnmatch( pattern, &value[size - cut], 0 ) == 0 )
+            {
+                *length = size - cut;
+                break;
+            }
+            continue;
+        }
+
+        saved = copy[cut];
+        copy[cut] = '\0';
+        if( fnmatch( pattern, copy, 0 ) == 0 )
+        {
+            *length = size - cut;
+            return &value[cut];
+        }
+        copy[cut] = saved;
+    }
+
+    return value;
+} /* end trim_value() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: is_arithmetic                                 */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          const char* word: word being expanded                    */
+/*          int pos: index of a '$'                                  */
+/*                                                                   */
+/*      Description:                                                 */
+/*          "$((" starts arithmetic when it ends with "))", and a    */
+/*          command substitution in a subshell otherwise.            */
+/*                                                                   */
+/*********************************************************************/
+static int is_arithmetic( const char* word, int pos )
+{
+    int end;
+
+    if( word[pos] != '$' || word[pos + 1] != '(' || word[pos + 2] != '(' )
+        return F;
+
+    end = find_substitution_end( word, pos );
+    return ( end != -1 && word[end - 2] == ')' );
+} /* end is_arithmetic() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: expand_arithmetic                             */
+/*      Return type:   const char* - result, NULL on failure         */
+/*      Parameter(s):                                                */
+/*          const char* word: word being expanded                    */
+/*          int* pos: index of the "$((", moved past the "))"        */
+/*          size_t* length: set to the length of the result          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          expands the variables and substitutions in the           */
+/*          expression, then evaluates it in the shell.              */
+/*                                                                   */
+/*********************************************************************/
+static const char* expand_arithmetic( const char* word, int* pos, size_t* length )
+{
+    int end = find_substitution_end( word, *pos );
+    char* expression;
+    long result;
+
+    expression = expand_nested( &word[*pos + 3], (size_t)( end - *pos - 5 ) );
+    *pos = end;
+
+    if( expression == NULL || arith_evaluate( expression, &result ) == FAILURE )
+        return NULL;
+
+    *length = (size_t)snprintf( number, sizeof(number), "%ld", result );
+    return number;
+} /* end expand_arithmetic() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: expand_nested                                 */
+/*      Return type:   char* (NULL on failure)                       */
+/*      Parameter(s):                                                */
+/*          const char* text: part of a word, e.g. ${x:-text}        */
+/*          size_t length: number of characters in text              */
+/*                                                                   */
+/*      Description:                                                 */
+/*          expands text as a word of its own into line_arena,       */
+/*          setting buffer aside while it does.                      */
+/*                                                                   */
+/*********************************************************************/
+static char* expand_nested( const char* text, size_t length )
+{
+    expand_buffer saved = buffer;
+    char* copy, * result = NULL;
+
+    if( ( copy = arena_strndup( &line_arena, text, length ) ) == NULL )
+        return NULL;
+
+    buffer.data = NULL;
+    buffer.length = buffer.capacity = 0;
+
+    if( expand_text( copy, NULL ) == SUCCESS )
+        result = arena_strndup( &line_arena, ( buffer.data == NULL ? "" : buffer.data ), buffer.length );
+
+    free( buffer.data );
+    buffer = saved;
+
+    return result;
+} /* end expand_nested() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: substitute                                    */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* word: word being expanded                    */
+/*          int* pos: index of the "$(" or '`', moved past the end   */
+/*          word_vector* out: fields to split the output into, NULL  */
+/*                            to add it to buffer as is              */
+/*          int* quoted: T while the current field must be kept      */
+/*                       even when it is empty                       */
+/*                                                                   */
+/*      Description:                                                 */
+/*          runs the command of a $(...) or `...` and adds what it   */
+/*          printed. The command may expand words of its own, so     */
+/*          buffer and fields are set aside while it runs.           */
+/*                                                                   */
+/*********************************************************************/
+static int substitute( const char* word, int* pos, word_vector* out, int* quoted )
+{
+    expand_buffer saved_buffer = buffer;
+    word_vector saved_fields = fields;
+    const char* text;
+    char* output;
+    size_t length, output_length;
+    int end, result;
+
+    if( ( end = find_substitution_end( word, *pos ) ) == -1 )
+    {
+        fprintf( stderr, "Error: command substitution is not closed - %s\n", word );
+        return FAILURE;
+    }
+
+    // the command between "$(" and ')', or between the backticks
+    // with the backslashes before ` \ and $ removed
+    if( word[*pos] == '`' )
+    {
+        length = (size_t)( end - *pos - 2 );
+        if( ( text = unescape_backticks( &word[*pos + 1], &length ) ) == NULL )
+            return FAILURE;
+    }
+    else
+    {
+        text = &word[*pos + 2];
+        length = (size_t)( end - *pos - 3 );
+    }
+    *pos = end;
+
+    buffer.data = NULL;
+    buffer.length = buffer.capacity = 0;
+    fields.words = NULL;
+    fields.kinds = NULL;
+    fields.count = fields.capacity = 0;
+
+    result = capture_command( text, length, &output, &output_length );
+    substitution_status = last_status;
+
+    free( buffer.data );
+    free_strings( &fields );
+    buffer = saved_buffer;
+    fields = saved_fields;
+
+    if( result == SUCCESS )
+    {
+        if( out == NULL )
+            result = buffer_append( output, output_length );
+        else
+            result = split_append( output, output_length, out, quoted );
+    }
+
+    free( output );
+    return result;
+} /* end substitute() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: unescape_backticks                            */
+/*      Return type:   char* (NULL on failure)                       */
+/*      Parameter(s):                                                */
+/*          const char* text: command between the backticks          */
+/*          size_t* length: length of text, set to the new length    */
+/*                                                                   */
+/*      Description:                                                 */
+/*          copies text into line_arena without the backslashes      */
+/*          before ` \ and $, which only hide those characters from  */
+/*          the backticks.                                           */
+/*                                                                   */
+/*********************************************************************/
+static char* unescape_backticks( const char* text, size_t* length )
+{
+    char* copy;
+    size_t i, n = 0;
+
+    if( ( copy = (char*)arena_alloc( &line_arena, *length + 1 ) ) == NULL )
+        return NULL;
+
+    for( i = 0; i < *length; i++ )
+    {
+        if( text[i] == '\\' && i + 1 < *length && strchr( "`\\$", text[i + 1] ) != NULL )
+            i++;
+        copy[n++] = text[i];
+    }
+    copy[n] = '\0';
+
+    *length = n;
+    return copy;
+} /* end unescape_backticks() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: split_append                                  */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* text: output of a command substitution       */
+/*          size_t length: number of characters in text              */
+/*          word_vector* out: fields being built                     */
+/*          int* quoted: T while the current field must be kept      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          adds text to buffer, ending the field at every run of    */
+/*          spaces, tabs and newlines.                               */
+/*                                                                   */
+/*********************************************************************/
+static int split_append( const char* text, size_t length, word_vector* out, int* quoted )
+{
+    size_t i = 0, run;
+
+    while( i < length )
+    {
+        if( text[i] == ' ' || text[i] == '\t' || text[i] == '\n' )
+        {
+            if( ( buffer.length > 0 || *quoted ) && push_field( out ) == FAILURE )
+                return FAILURE;
+            *quoted = F;
+            i++;
+            continue;
+        }
+
+        for( run = i + 1; run < length && text[run] != ' ' && text[run] != '\t' && text[run] != '\n'; run++ )
+            continue;
+
+        if( buffer_append( &text[i], run - i ) == FAILURE )
+            return FAILURE;
+        i = run;
+    }
+
+    return SUCCESS;
+} /* end split_append() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: push_field                                    */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          word_vector* out: fields being built                     */
+/*                                                                   */
+/*      Description:                                                 */
+/*          copies buffer into line_arena as the next field and      */
+/*          empties it.                                              */
+/*                                                                   */
+/*********************************************************************/
+static int push_field( word_vector* out )
+{
+    char* field;
+
+    if( ( field = arena_strndup( &line_arena, ( buffer.data == NULL ? "" : buffer.data ), buffer.length ) ) == NULL )
+        return FAILURE;
+
+    buffer.length = 0;
+    return push_string( field, out );
+} /* end push_field() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: buffer_append                                 */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* text: characters to add                      */
+/*          size_t length: number of characters                      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          appends text to buffer, doubling it when it is full.     */
+/*                                                                   */
+/*********************************************************************/
+static int buffer_append( const char* text, size_t length )
+{
+    size_t new_capacity;
+    char* grown;
+
+    // an empty value, the buffer may not even exist yet
+    if( length == 0 )
+        return SUCCESS;
+
+    if( buffer.length + length > buffer.capacity )
+    {
+        new_capacity = ( buffer.capacity == 0 ? EXPAND_START_SIZE : buffer.capacity );
+        while( new_capacity < buffer.length + length )
+            new_capacity *= 2;
+
+        if( ( grown = (char*)realloc( buffer.data, new_capacity ) ) == NULL )
+        {
+            fprintf( stderr, "Error: could not grow word to %zu bytes\n", new_capacity );
+            return FAILURE;
+        }
+        buffer.data = grown;
+        buffer.capacity = new_capacity;
+    }
+
+    memcpy( &buffer.data[buffer.length], text, length );
+    buffer.length += length;
+
+    return SUCCESS;
+} /* end buffer_append() */
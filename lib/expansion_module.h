@@ -0,0 +1,56 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: expansion_module.h                          */
+/*          Description:                                             */
+/*              This module expands the words of a pipeline right    */
+/*              before it runs: $VAR, ${VAR} and $? are replaced by  */
+/*              their values, ${VAR:-x}, ${#VAR}, ${VAR%x} and the   */
+/*              like are worked out, $(( )) is evaluated, $(...) and */
+/*              `...` are replaced by the output of the command, and */
+/*              quotes and backslashes are removed, all in one pass  */
+/*              over each word.                                      */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef EXPANSION_MODULE_H
+#define EXPANSION_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fnmatch.h>
+#include "string_module.h"
+#include "parse_module.h"
+#include "arena_module.h"
+#include "variable_module.h"
+#include "arith_module.h"
+
+/* macros */
+#define EXPAND_START_SIZE 256
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* growable buffer a word is expanded into */
+typedef struct expand_buffer_t
+{
+    char*   data;
+    size_t  length;
+    size_t  capacity;
+} expand_buffer;
+
+/* globals */
+extern int last_status;
+extern int substitution_status;     /* of the last $(...) expanded */
+
+/* function prototypes */
+int     expand_pipeline( command_list* list, pipeline* pl );
+char*   expand_word( char* word );
+void    free_expansion( void );
+
+#endif
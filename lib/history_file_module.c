@@ -0,0 +1,440 @@
+#include "history_file_module.h"
+
+/* globals */
+static history_file store = { -1, NULL, 0, NULL, 0, 0, 0, 0, "", "" };
+
+/* static function prototypes */
+static int     load_index( void );
+static int     save_index( void );
+static int     refresh_history_file( void );
+static int     reopen_history_file( struct stat* info );
+static int     add_offset( uint64_t offset );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: open_history_file                             */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* path: the history file                       */
+/*                                                                   */
+/*      Description:                                                 */
+/*          opens path for reading and indexes it, starting from the */
+/*          saved index when it still matches the file.              */
+/*                                                                   */
+/*********************************************************************/
+int open_history_file( const char* path )
+{
+    snprintf( store.path, sizeof(store.path), "%s", path );
+    snprintf( store.index_path, sizeof(store.index_path), "%s%s", path, HISTORY_INDEX_SUFFIX );
+
+    if( ( store.fd = open_for_shell( path, O_RDONLY, 0 ) ) == -1 )
+        return FAILURE;
+
+    // a missing or stale index is rebuilt from the start
+    if( load_index() == FAILURE )
+    {
+        store.count = store.saved = 0;
+        if( add_offset( 0 ) == FAILURE )
+            return FAILURE;
+    }
+
+    return refresh_history_file();
+} /* end open_history_file() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: history_file_count                            */
+/*      Return type:   size_t                                        */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          returns the number of entries in the file, indexing the  */
+/*          ones appended since the last call first.                 */
+/*                                                                   */
+/*********************************************************************/
+size_t history_file_count( void )
+{
+    refresh_history_file();
+    return store.count;
+} /* end history_file_count() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: history_file_inode                            */
+/*      Return type:   uint64_t - 0 when there is no file            */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          returns the inode of the file being read, which changes  */
+/*          when another file is moved over it.                      */
+/*                                                                   */
+/*********************************************************************/
+uint64_t history_file_inode( void )
+{
+    struct stat info;
+
+    if( store.fd == -1 || fstat( store.fd, &info ) == -1 )
+        return 0;
+
+    return (uint64_t)info.st_ino;
+} /* end history_file_inode() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: history_file_entry                            */
+/*      Return type:   const char* - command, NULL if there is none  */
+/*      Parameter(s):                                                */
+/*          size_t n: number of the entry, starting at 1             */
+/*          size_t* length: set to the length of the command         */
+/*                                                                   */
+/*      Description:                                                 */
+/*          finds entry n through the index. The command points into */
+/*          the mapping and is not terminated. n must not be more    */
+/*          than history_file_count().                               */
+/*                                                                   */
+/*********************************************************************/
+const char* history_file_entry( size_t n, size_t* length )
+{
+    const char* start, * end;
+
+    if( n == 0 || n > store.count )
+        return NULL;
+
+    // the entry ends with a '\n' right before the next one
+    start = store.map + store.offsets[n - 1];
+    end = store.map + store.offsets[n] - 1;
+    start = skip_history_fields( start, end );
+
+    *length = (size_t)( end - start );
+    return start;
+} /* end history_file_entry() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: skip_history_fields                           */
+/*      Return type:   const char* - start of the command            */
+/*      Parameter(s):                                                */
+/*          const char* line: line of the history file               */
+/*          const char* end: end of the line                         */
+/*                                                                   */
+/*      Description:                                                 */
+/*          skips the time and status before the command. Lines the  */
+/*          older versions wrote start with "number\t" instead.      */
+/*                                                                   */
+/*********************************************************************/
+const char* skip_history_fields( const char* line, const char* end )
+{
+    const char* p = line;
+    int fields;
+
+    for( fields = 0; fields < 2; fields++ )
+    {
+        if( p < end && *p == '-' )
+            p++;
+        if( p == end || !isdigit( (unsigned char)*p ) )
+            break;
+        while( p < end && isdigit( (unsigned char)*p ) )
+            p++;
+        if( p == end || *p != '\t' )
+            break;
+        line = ++p;
+    }
+
+    return line;
+} /* end skip_history_fields() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: close_history_file                            */
+/*      Return type:   void                                          */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          saves the index if it grew, then unmaps and closes the   */
+/*          file.                                                    */
+/*                                                                   */
+/*********************************************************************/
+void close_history_file( void )
+{
+    if( store.fd == -1 )
+        return;
+
+    refresh_history_file();
+    if( store.count != store.saved )
+        save_index();
+
+    if( store.map != NULL )
+        munmap( store.map, store.mapped );
+    close( store.fd );
+    free( store.offsets );
+
+    store.fd = -1;
+    store.map = NULL;
+    store.offsets = NULL;
+    store.mapped = store.count = store.capacity = store.saved = 0;
+} /* end close_history_file() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: refresh_history_file                          */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          maps the file again if its size changed and indexes the  */
+/*          complete entries after the last one indexed. An entry    */
+/*          still being written, without its '\n', waits for the     */
+/*          next call. A file cut short or replaced by something     */
+/*          else is indexed again from the start, and never more     */
+/*          than the file holds is mapped, since reading a mapping   */
+/*          past the end of the file raises SIGBUS.                  */
+/*                                                                   */
+/*********************************************************************/
+static int refresh_history_file( void )
+{
+    struct stat info, named;
+    const char* p, * end, * newline;
+    void* map;
+
+    if( store.fd == -1 || fstat( store.fd, &info ) == -1 )
+        return FAILURE;
+
+    // another file was moved to the path, read that one instead
+    if( stat( store.path, &named ) == 0 && named.st_ino != info.st_ino &&
+        reopen_history_file( &info ) == FAILURE )
+        return FAILURE;
+
+    // the file was cut short by something else, start over
+    if( (uint64_t)info.st_size < store.offsets[store.count] )
+    {
+        store.count = store.saved = 0;
+        store.offsets[0] = 0;
+    }
+
+    if( (size_t)info.st_size != store.mapped )
+    {
+        map = NULL;
+        if( info.st_size > 0 &&
+            ( map = mmap( NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, store.fd, 0 ) ) == MAP_FAILED )
+        {
+            fprintf( stderr, "Error: could not map the history file - %s\n", strerror( errno ) );
+            return FAILURE;
+        }
+        if( store.map != NULL )
+            munmap( store.map, store.mapped );
+        store.map = (char*)map;
+        store.mapped = (size_t)info.st_size;
+    }
+
+    // nothing is mapped while the file is empty
+    if( store.map == NULL )
+        return SUCCESS;
+
+    p = store.map + store.offsets[store.count];
+    end = store.map + store.mapped;
+
+    while( p < end && ( newline = (const char*)memchr( p, '\n', (size_t)( end - p ) ) ) != NULL )
+    {
+        if( add_offset( (uint64_t)( newline + 1 - store.map ) ) == FAILURE )
+            return FAILURE;
+        p = newline + 1;
+    }
+
+    return SUCCESS;
+} /* end refresh_history_file() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: reopen_history_file                           */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          struct stat* info: set to the status of the new file     */
+/*                                                                   */
+/*      Description:                                                 */
+/*          opens the file now at the history path in place of the   */
+/*          one the shell had, and forgets the old index and         */
+/*          mapping.                                                 */
+/*                                                                   */
+/*********************************************************************/
+static int reopen_history_file( struct stat* info )
+{
+    int fd;
+
+    if( ( fd = open_for_shell( store.path, O_RDONLY, 0 ) ) == -1 )
+        return FAILURE;
+
+    if( fstat( fd, info ) == -1 )
+    {
+        close( fd );
+        return FAILURE;
+    }
+
+    if( store.map != NULL )
+        munmap( store.map, store.mapped );
+    close( store.fd );
+
+    store.fd = fd;
+    store.inode = (uint64_t)info->st_ino;
+    store.map = NULL;
+    store.mapped = store.count = store.saved = 0;
+    store.offsets[0] = 0;
+
+    return SUCCESS;
+} /* end reopen_history_file() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: add_offset                                    */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          uint64_t offset: where the next entry starts             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          ends the entry being indexed at offset. The first call   */
+/*          only sets where entry 1 starts.                          */
+/*                                                                   */
+/*********************************************************************/
+static int add_offset( uint64_t offset )
+{
+    size_t slot = ( store.offsets == NULL ? 0 : store.count + 1 );
+    size_t new_capacity;
+    uint64_t* grown;
+
+    if( slot >= store.capacity )
+    {
+        new_capacity = ( store.capacity == 0 ? HISTORY_INDEX_START_SIZE : store.capacity * 2 );
+        if( ( grown = (uint64_t*)realloc( store.offsets, new_capacity * sizeof(uint64_t) ) ) == NULL )
+        {
+            fprintf( stderr, "Error allocating memory for the history index.\n" );
+            return FAILURE;
+        }
+        store.offsets = grown;
+        store.capacity = new_capacity;
+    }
+
+    store.offsets[slot] = offset;
+    store.count = slot;
+
+    return SUCCESS;
+} /* end add_offset() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: load_index                                    */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          reads ~/.j_history.idx. It is only used when it was made */
+/*          for this file, the file is at least as long as what it   */
+/*          covers and an entry ends right where it stops. Its size  */
+/*          must match the count in its header and the offsets must  */
+/*          go up from 0 to what it covers, else it is rebuilt.      */
+/*                                                                   */
+/*********************************************************************/
+static int load_index( void )
+{
+    history_index_header header;
+    struct stat info, index_info;
+    char last;
+    size_t size, i;
+    int fd, result = FAILURE;
+
+    if( fstat( store.fd, &info ) == -1 || ( fd = open_for_shell( store.index_path, O_RDONLY, 0 ) ) == -1 )
+        return FAILURE;
+
+    store.inode = (uint64_t)info.st_ino;
+
+    // the count is checked against the size first, so count + 1
+    // offsets are known to fit in memory and in the file
+    if( fstat( fd, &index_info ) == 0 && (size_t)index_info.st_size > sizeof(header) &&
+        ( (size_t)index_info.st_size - sizeof(header) ) % sizeof(uint64_t) == 0 &&
+        read( fd, &header, sizeof(header) ) == (ssize_t)sizeof(header) &&
+        memcmp( header.magic, HISTORY_INDEX_MAGIC, sizeof(header.magic) ) == 0 &&
+        header.count == ( (size_t)index_info.st_size - sizeof(header) ) / sizeof(uint64_t) - 1 &&
+        header.inode == store.inode && header.indexed <= (uint64_t)info.st_size &&
+        ( header.indexed == 0 ||
+          ( pread( store.fd, &last, 1, (off_t)header.indexed - 1 ) == 1 && last == '\n' ) ) )
+    {
+        size = ( (size_t)header.count + 1 ) * sizeof(uint64_t);
+        store.capacity = (size_t)header.count + HISTORY_INDEX_START_SIZE;
+
+        if( ( store.offsets = (uint64_t*)malloc( store.capacity * sizeof(uint64_t) ) ) != NULL &&
+            read( fd, store.offsets, size ) == (ssize_t)size &&
+            store.offsets[0] == 0 && store.offsets[header.count] == header.indexed )
+        {
+            // every entry holds at least its '\n'
+            for( i = 0; i < header.count && store.offsets[i] < store.offsets[i + 1]; i++ )
+                continue;
+            result = ( i == header.count ? SUCCESS : FAILURE );
+        }
+
+        if( result == SUCCESS )
+            store.count = store.saved = (size_t)header.count;
+        else
+        {
+            free( store.offsets );
+            store.offsets = NULL;
+            store.capacity = 0;
+        }
+    }
+
+    close( fd );
+    return result;
+} /* end load_index() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: save_index                                    */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          writes the index to a temporary file and renames it over */
+/*          ~/.j_history.idx, so a reader never sees half of one.    */
+/*                                                                   */
+/*********************************************************************/
+static int save_index( void )
+{
+    history_index_header header;
+    struct stat info;
+    char path[PATH_MAX + 8];
+    size_t size = ( store.count + 1 ) * sizeof(uint64_t);
+    int fd, written;
+
+    if( fstat( store.fd, &info ) == -1 )
+        return FAILURE;
+
+    memcpy( header.magic, HISTORY_INDEX_MAGIC, sizeof(header.magic) );
+    header.inode = (uint64_t)info.st_ino;
+    header.indexed = store.offsets[store.count];
+    header.count = store.count;
+
+    snprintf( path, sizeof(path), "%s.tmp", store.index_path );
+    if( ( fd = open_for_shell( path, O_WRONLY | O_CREAT | O_TRUNC, 0600 ) ) == -1 )
+        return FAILURE;
+
+    written = ( write( fd, &header, sizeof(header) ) == (ssize_t)sizeof(header) &&
+                write( fd, store.offsets, size ) == (ssize_t)size );
+    close( fd );
+
+    if( !written || rename( path, store.index_path ) == -1 )
+    {
+        unlink( path );
+        return FAILURE;
+    }
+
+    store.saved = store.count;
+    return SUCCESS;
+} /* end save_index() */
@@ -0,0 +1,77 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: history_file_module.h                       */
+/*          Description:                                             */
+/*              This module reads the history file back. The file is */
+/*              mapped into memory and indexed by the offset where   */
+/*              each entry starts, so entry n is found without       */
+/*              reading the ones before it. The index is saved next  */
+/*              to the file (~/.j_history.idx) when the shell exits  */
+/*              and loaded at startup, and only the entries appended */
+/*              since are scanned.                                   */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef HISTORY_FILE_MODULE_H
+#define HISTORY_FILE_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "string_module.h"
+#include "execution_module.h"
+
+/* macros */
+#define HISTORY_INDEX_SUFFIX ".idx"
+#define HISTORY_INDEX_MAGIC "JHIDX01\n"     /* 8 bytes, changes with the format */
+#define HISTORY_INDEX_START_SIZE 1024
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* start of ~/.j_history.idx, the offsets follow it */
+typedef struct history_index_header_t
+{
+    char        magic[8];
+    uint64_t    inode;      /* of the history file it indexes    */
+    uint64_t    indexed;    /* bytes of the file covered         */
+    uint64_t    count;      /* entries, count + 1 offsets follow */
+} history_index_header;
+
+/* the mapped history file and its index */
+typedef struct history_file_t
+{
+    int         fd;             /* -1 when there is no file           */
+    char*       map;            /* NULL while the file is empty       */
+    size_t      mapped;         /* bytes mapped                       */
+    uint64_t*   offsets;        /* start of every entry, the last one */
+                                /* is where the next entry will start */
+    size_t      count;          /* entries indexed                    */
+    size_t      capacity;       /* offsets allocated                  */
+    size_t      saved;          /* entries in the index file          */
+    uint64_t    inode;
+    char        path[PATH_MAX];
+    char        index_path[PATH_MAX];
+} history_file;
+
+/* function prototypes */
+int         open_history_file( const char* path );
+size_t      history_file_count( void );
+uint64_t    history_file_inode( void );
+const char* history_file_entry( size_t n, size_t* length );
+const char* skip_history_fields( const char* line, const char* end );
+void        close_history_file( void );
+
+#endif
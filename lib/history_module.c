@@ -1,35 +1,189 @@
 #include "history_module.h"
 
 /* globals */
-int     n_history = 0;
-char*   history[HISTORY_LIMIT];
+static history_store store;                 /* the last histsize commands */
+static int      pending = F;                /* last command not logged    */
+static size_t   in_file = 0;                /* entries of the file and    */
+static size_t   written = 0;                /* records written, when      */
+                                            /* history_count() looked     */
+static history_writer writer = { .fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER,
+                                 .wake = PTHREAD_COND_INITIALIZER,
+                                 .finished = PTHREAD_COND_INITIALIZER };
+
+/* static function prototypes */
+static void*        write_history( void* arg );
+static int          write_records( int fd, struct iovec* parts, int n );
+static int          store_entry( const char* line, size_t length );
+static void         drop_entries( size_t keep );
+static size_t       unwritten_entries( void );
+static void         drop_last_entry( void );
+static void         wait_for_writer( void );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: init_history                                  */
+/*      Return type:   int                                           */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          opens ~/.j_history for appending, creating it if needed, */
+/*          and indexes it, then starts the thread that writes the   */
+/*          file. The file stays open until free_history(). Without  */
+/*          it the history is only kept in memory. A child of fork() */
+/*          has no writer, so fork() waits for the ring to be empty. */
+/*                                                                   */
+/*********************************************************************/
+int init_history( void )
+{
+    const char* home = get_variable( "HOME" );
+    char path[PATH_MAX];
+
+    snprintf( path, sizeof(path), "%s%s", ( home == NULL ? "." : home ), HISTORY_FILE );
+
+    if( ( writer.fd = open_for_shell( path, O_RDWR | O_APPEND | O_CREAT, 0600 ) ) == -1 )
+    {
+        fprintf( stderr, "Error: could not open %s to write history - %s\n", path, strerror( errno ) );
+        return FAILURE;
+    }
+
+    open_history_file( path );
+
+    // without the thread, log_history() writes the file itself
+    writer.running = ( pthread_create( &writer.thread, NULL, write_history, NULL ) == 0 );
+    if( writer.running )
+        pthread_atfork( wait_for_writer, NULL, NULL );
+
+    return SUCCESS;
+} /* end init_history() */
+
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: add_cmds_to_history                           */
+/*      Function name: add_to_history                                */
 /*      Return type:   int                                           */
 /*      Parameter(s):                                                */
-/*          char* cmds:   command to add to history array            */
+/*          char* line: command to add to history array              */
+/*                                                                   */
+/*      Description:                                                 */
+/*          keeps a copy of line, the oldest command is dropped once */
+/*          histsize are kept. It is written to the file by          */
+/*          log_history() once its exit status is known. A command   */
+/*          the same as the last one entered, or the last one of the */
+/*          file when none was, is not added again.                  */
 /*                                                                   */
 /*********************************************************************/
 int add_to_history( char* line )
 {
-    // if history array is maxed out, write to a file
-    if ( n_history == CMD_LIMIT )
-        write_history_to_file();
+    const char* last;
+    size_t length;
+
+    // nothing was entered
+    if( *line == '\0' )
+        return SUCCESS;
+
+    // repeating the last command adds nothing
+    if( store.count > store.head )
+    {
+        last = store.text + store.offsets[store.count - 1];
+        length = strlen( last );
+    }
+    else
+        last = find_history_entry( history_count(), &length );
+
+    if( last != NULL && length == strlen( line ) && memcmp( line, last, length ) == 0 )
+        return SUCCESS;
+
+    if( store_entry( line, strlen( line ) ) == FAILURE )
+        return FAILURE;
+
+    pending = T;
+    return SUCCESS;
+} /* end add_to_history() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: log_history                                   */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          int status: exit status of the last command added        */
+/*                                                                   */
+/*      Description:                                                 */
+/*          hands the last command added to the writer thread. The   */
+/*          shell never waits for the file: when the ring is full    */
+/*          the entry is dropped with an error instead.              */
+/*                                                                   */
+/*********************************************************************/
+int log_history( int status )
+{
+    static int dropping = F;
+    history_record record;
+    struct iovec part;
+    const char* line;
+    size_t head, length;
+    int n;
+
+    if( !pending || writer.fd == -1 )
+        return SUCCESS;
+
+    pending = F;
+    line = store.text + store.offsets[store.count - 1];
+    length = store.used - store.offsets[store.count - 1] - 1;
+
+    // the writer frees the record once it is in the file
+    if( ( record.text = (char*)malloc( length + 48 ) ) == NULL )
+    {
+        fprintf( stderr, "Error allocating memory for history.\n" );
+        return FAILURE;
+    }
+    n = snprintf( record.text, 48, "%lld\t%d\t", (long long)time( NULL ), status );
+    memcpy( record.text + n, line, length );
+    record.text[n + length] = '\n';
+    record.length = (size_t)n + length + 1;
+    record.sync_every = get_option( OPTION_HISTSYNC );
+
+    if( !writer.running )
+    {
+        part.iov_base = record.text;
+        part.iov_len = record.length;
+        n = write_records( writer.fd, &part, 1 );
+        if( n == FAILURE )
+            drop_last_entry();
+        else if( record.sync_every > 0 && ++writer.unsynced >= record.sync_every )
+        {
+            fdatasync( writer.fd );
+            writer.unsynced = 0;
+        }
+        free( record.text );
+        return n;
+    }
 
-    // allocate memory for commands
-    if ( ( history[n_history] = (char*)malloc( ( strlen(line) + 1 ) * sizeof(char) ) ) == NULL )
+    head = atomic_load_explicit( &writer.head, memory_order_relaxed );
+    if( head - atomic_load_explicit( &writer.tail, memory_order_acquire ) == HISTORY_RING_SIZE )
     {
-        fprintf( stderr, "Error allocating memory for history." );
-        return FAILURE; 
+        // once for every run of dropped commands
+        if( !dropping )
+            fprintf( stderr, "Error: history file is too slow, commands are not being saved\n" );
+        dropping = T;
+        free( record.text );
+        drop_last_entry();
+        return FAILURE;
     }
+    dropping = F;
 
-    // copy line into history array
-    strcpy( history[n_history++], line );
+    writer.ring[head & ( HISTORY_RING_SIZE - 1 )] = record;
+    atomic_store( &writer.head, head + 1 );
+
+    // only wake the writer up when it went to sleep, which it
+    // does after setting sleeping and looking at head once more
+    if( atomic_load( &writer.sleeping ) )
+    {
+        pthread_mutex_lock( &writer.lock );
+        pthread_cond_signal( &writer.wake );
+        pthread_mutex_unlock( &writer.lock );
+    }
 
     return SUCCESS;
-} /* end add_cmds_to_history() */
+} /* end log_history() */
 
 
 /*********************************************************************/
@@ -42,46 +196,213 @@ int add_to_history( char* line )
 /*********************************************************************/
 void print_history( FILE *fp )
 {
-    int i;
-    for( i = 0; i < n_history; i++ )
-        fprintf( fp, "%d\t%s\n", i + 1, history[i] );
+    long count = history_count();
 
+    print_history_range( fp, count - get_option( OPTION_HISTSIZE ) + 1, count );
 } /* end print_history() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: write_history_to_file                         */
+/*      Function name: print_history_range                           */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          FILE* fp: where to print                                 */
+/*          long first: number of the first command to print         */
+/*          long last: number of the last command to print           */
+/*                                                                   */
+/*      Description:                                                 */
+/*          prints commands first to last. The ones not kept in      */
+/*          memory are found in the file through its index, so       */
+/*          printing the end of a long history reads only the end.   */
+/*                                                                   */
+/*********************************************************************/
+void print_history_range( FILE* fp, long first, long last )
+{
+    const char* entry;
+    size_t length;
+    long count = history_count();
+
+    if( first < 1 )
+        first = 1;
+    if( last > count )
+        last = count;
+
+    for( ; first <= last; first++ )
+    {
+        if( ( entry = find_history_entry( first, &length ) ) != NULL )
+            fprintf( fp, "%ld\t%.*s\n", first, (int)length, entry );
+    }
+} /* end print_history_range() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: expand_history                                */
 /*      Return type:   int                                           */
-/*      Parameter(s): none                                           */
+/*      Parameter(s):                                                */
+/*          char** line: line the user entered, replaced by the      */
+/*                       expanded line when it refers to history     */
+/*                                                                   */
+/*      Description:                                                 */
+/*          replaces !! with the last command, !n with command n and */
+/*          !-n with the nth command back, except in single quotes   */
+/*          or after a backslash. The expanded line is printed, as   */
+/*          other shells do. Returns FAILURE when a command does not */
+/*          exist, line is left as it was.                           */
 /*                                                                   */
 /*********************************************************************/
-int write_history_to_file( void )
+int expand_history( char** line )
 {
-    char out_file[255];
-    sprintf( out_file, "%s%s", 
-        ( getenv( "HOME" ) == NULL ? ".": getenv( "HOME" ) ), "/.j_history" ); 
+    const char* p, * entry;
+    char* expanded = NULL, * end;
+    size_t size = 0, length;
+    int quoted = F, changed = F;
+    FILE* out;
+    long n, count;
 
-    char* mode = "a+";
-    FILE* fp; 
+    if( strchr( *line, '!' ) == NULL )
+        return SUCCESS;
 
-    // open file to write to
-    if( ( fp = fopen( out_file, mode ) ) == NULL )
+    if( ( out = open_memstream( &expanded, &size ) ) == NULL )
     {
-        fprintf( stderr, "Error. Could not open %s to write history.\n", out_file );
-        perror("Error");
+        fprintf( stderr, "Error allocating memory for history.\n" );
         return FAILURE;
     }
 
-    // write all history to outfile and free the memory
-    print_history( fp ); 
-    free_history();
+    count = history_count();
+
+    for( p = *line; *p != '\0'; p++ )
+    {
+        if( *p == '\\' && !quoted && p[1] != '\0' )
+        {
+            fputc( *p++, out );
+            fputc( *p, out );
+            continue;
+        }
+        if( *p == '\'' )
+            quoted = !quoted;
+
+        if( *p != '!' || quoted )
+        {
+            fputc( *p, out );
+            continue;
+        }
+
+        if( p[1] == '!' )
+        {
+            n = count;
+            end = (char*)p + 2;
+        }
+        else if( isdigit( (unsigned char)p[1] ) || ( p[1] == '-' && isdigit( (unsigned char)p[2] ) ) )
+        {
+            n = strtol( p + 1, &end, 10 );
+            if( n < 0 )
+                n += count + 1;
+        }
+        else
+        {
+            // a lone ! as in "[ a != b ]"
+            fputc( *p, out );
+            continue;
+        }
+
+        if( ( entry = find_history_entry( n, &length ) ) == NULL )
+        {
+            fprintf( stderr, "Error: event not found - %.*s\n", (int)( end - p ), p );
+            fclose( out );
+            free( expanded );
+            return FAILURE;
+        }
+
+        fwrite( entry, 1, length, out );
+        p = end - 1;
+        changed = T;
+    }
+
+    fclose( out );
+
+    if( !changed )
+    {
+        free( expanded );
+        return SUCCESS;
+    }
+
+    printf( "%s\n", expanded );
+    free( *line );
+    *line = expanded;
+
+    return SUCCESS;
+} /* end expand_history() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: history_count                                 */
+/*      Return type:   long - number of the last command             */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          indexes what was written to the file since the last look */
+/*          and counts its entries, then the commands of this shell  */
+/*          not in it yet. An entry the writer is adding meanwhile   */
+/*          would be counted in both, so this waits for the write,   */
+/*          HISTORY_WAIT_MS at most, and indexes again.              */
+/*          find_history_entry() numbers commands as they were at    */
+/*          this call.                                               */
+/*                                                                   */
+/*********************************************************************/
+long history_count( void )
+{
+    struct timespec pause = { 0, 1000000L };
+    int waited = 0;
+
+    while( 1 )
+    {
+        written = atomic_load_explicit( &writer.tail, memory_order_acquire );
+        in_file = history_file_count();
+
+        // writing is set before a write starts, when it is still
+        // written no entry past those can be in the file yet
+        if( atomic_load_explicit( &writer.writing, memory_order_acquire ) == written ||
+            waited++ == HISTORY_WAIT_MS )
+            break;
+        nanosleep( &pause, NULL );
+    }
+
+    return (long)( in_file + unwritten_entries() );
+} /* end history_count() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_history_entry                            */
+/*      Return type:   const char* - command, NULL if there is none  */
+/*      Parameter(s):                                                */
+/*          long n: number of the command                            */
+/*          size_t* length: set to the length of the command         */
+/*                                                                   */
+/*      Description:                                                 */
+/*          finds command n, line n of the file, or one of the       */
+/*          commands kept in memory that are not written yet when n  */
+/*          is past the end of the file. Numbers are those of the    */
+/*          last history_count(). The command is good until the next */
+/*          one is added.                                            */
+/*                                                                   */
+/*********************************************************************/
+const char* find_history_entry( long n, size_t* length )
+{
+    size_t unwritten = unwritten_entries(), i;
+
+    if( n < 1 || n > (long)( in_file + unwritten ) )
+        return NULL;
 
-    // close file
-    fclose( fp );
+    if( (size_t)n <= in_file )
+        return history_file_entry( (size_t)n, length );
 
-    return SUCCESS; 
-} /* end write_history_to_file() */
+    i = store.count - unwritten + ( (size_t)n - in_file - 1 );
+    *length = ( i + 1 < store.count ? store.offsets[i + 1] : store.used ) - store.offsets[i] - 1;
+    return store.text + store.offsets[i];
+} /* end find_history_entry() */
 
 
 /*********************************************************************/
@@ -90,16 +411,357 @@ int write_history_to_file( void )
 /*      Return type:   int                                           */
 /*      Parameter(s):  none                                          */
 /*      Description:                                                 */
-/*          Frees all memory allocated for history array.            */
+/*          Frees all memory allocated for history, waits at         */
+/*          most HISTORY_DRAIN_MS for the writer to empty the ring   */
+/*          and closes the file. A writer stuck on the disk is left  */
+/*          behind with the file open.                               */
 /*                                                                   */
 /*********************************************************************/
 int free_history( void )
 {
-    int i; 
-    for( i = 0; i < n_history; i++ )
-        free( history[i] );
+    struct timespec deadline;
+    int finished = T;
+
+    free( store.text );
+    free( store.offsets );
+    memset( &store, 0, sizeof(store) );
+    pending = F;
+    in_file = written = 0;
+
+    if( writer.running )
+    {
+        clock_gettime( CLOCK_REALTIME, &deadline );
+        deadline.tv_sec += HISTORY_DRAIN_MS / 1000;
+        deadline.tv_nsec += ( HISTORY_DRAIN_MS % 1000 ) * 1000000L;
+        if( deadline.tv_nsec >= 1000000000L )
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        pthread_mutex_lock( &writer.lock );
+        atomic_store( &writer.stopping, T );
+        pthread_cond_signal( &writer.wake );
+        while( !writer.done && pthread_cond_timedwait( &writer.finished, &writer.lock, &deadline ) == 0 )
+            continue;
+        finished = writer.done;
+        pthread_mutex_unlock( &writer.lock );
+
+        if( !finished )
+        {
+            fprintf( stderr, "Error: history file is too slow, the last commands may not be saved\n" );
+            return FAILURE;
+        }
+
+        pthread_join( writer.thread, NULL );
+        writer.running = F;
+    }
+
+    // saves the index, with what the writer appended, for the next shell
+    close_history_file();
 
-    n_history = 0;
+    if( writer.fd != -1 )
+    {
+        if( writer.unsynced > 0 )
+            fdatasync( writer.fd );
+        close( writer.fd );
+        writer.fd = -1;
+    }
 
-    return SUCCESS; 
+    return SUCCESS;
 } /* end free_history() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: write_history                                 */
+/*      Return type:   void* - always NULL                           */
+/*      Parameter(s):                                                */
+/*          void* arg: unused                                        */
+/*                                                                   */
+/*      Description:                                                 */
+/*          body of the writer thread. Takes every entry waiting in  */
+/*          the ring, up to HISTORY_BATCH, and appends them with a   */
+/*          single writev(), then sleeps until the shell adds more.  */
+/*          Returns once the shell is exiting and the ring is empty. */
+/*                                                                   */
+/*********************************************************************/
+static void* write_history( void* arg )
+{
+    struct iovec parts[HISTORY_BATCH];
+    history_record* record;
+    size_t head, tail;
+    int i, n;
+    long sync_every;
+
+    while( 1 )
+    {
+        tail = atomic_load_explicit( &writer.tail, memory_order_relaxed );
+        head = atomic_load_explicit( &writer.head, memory_order_acquire );
+
+        if( head == tail )
+        {
+            if( atomic_load( &writer.stopping ) )
+                break;
+
+            // look at head again after saying we sleep, so an entry
+            // added in between is either seen here or wakes us up
+            pthread_mutex_lock( &writer.lock );
+            atomic_store( &writer.sleeping, T );
+            if( atomic_load( &writer.head ) == tail && !atomic_load( &writer.stopping ) )
+                pthread_cond_wait( &writer.wake, &writer.lock );
+            atomic_store( &writer.sleeping, F );
+            pthread_mutex_unlock( &writer.lock );
+            continue;
+        }
+
+        n = (int)( head - tail < HISTORY_BATCH ? head - tail : HISTORY_BATCH );
+        for( i = 0; i < n; i++ )
+        {
+            record = &writer.ring[( tail + (size_t)i ) & ( HISTORY_RING_SIZE - 1 )];
+            parts[i].iov_base = record->text;
+            parts[i].iov_len = record->length;
+        }
+
+        // said before the entries can be in the file, see history_count()
+        atomic_store_explicit( &writer.writing, tail + (size_t)n, memory_order_release );
+        write_records( writer.fd, parts, n );
+        sync_every = record->sync_every;
+
+        for( i = 0; i < n; i++ )
+            free( writer.ring[( tail + (size_t)i ) & ( HISTORY_RING_SIZE - 1 )].text );
+
+        // the entries are in the file, the sync need not be waited for
+        atomic_store_explicit( &writer.tail, tail + (size_t)n, memory_order_release );
+
+        // group commit, one fsync for every histsync entries
+        writer.unsynced += n;
+        if( sync_every > 0 && writer.unsynced >= sync_every )
+        {
+            fdatasync( writer.fd );
+            writer.unsynced = 0;
+        }
+    }
+
+    pthread_mutex_lock( &writer.lock );
+    writer.done = T;
+    pthread_cond_signal( &writer.finished );
+    pthread_mutex_unlock( &writer.lock );
+
+    return NULL;
+} /* end write_history() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: write_records                                 */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          int fd: history file                                     */
+/*          struct iovec* parts: entries to append, changed as they  */
+/*                               are written                         */
+/*          int n: number of entries                                 */
+/*                                                                   */
+/*      Description:                                                 */
+/*          appends every entry, calling writev() again after a      */
+/*          short write.                                             */
+/*                                                                   */
+/*********************************************************************/
+static int write_records( int fd, struct iovec* parts, int n )
+{
+    ssize_t written;
+
+    while( n > 0 )
+    {
+        if( ( written = writev( fd, parts, n ) ) == -1 )
+        {
+            if( errno == EINTR )
+                continue;
+
+            fprintf( stderr, "Error: could not write history - %s\n", strerror( errno ) );
+            return FAILURE;
+        }
+
+        // skip what is written, part of an entry may be left
+        while( n > 0 && (size_t)written >= parts->iov_len )
+        {
+            written -= (ssize_t)parts->iov_len;
+            parts++;
+            n--;
+        }
+        if( n > 0 )
+        {
+            parts->iov_base = (char*)parts->iov_base + written;
+            parts->iov_len -= (size_t)written;
+        }
+    }
+
+    return SUCCESS;
+} /* end write_records() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: store_entry                                   */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          const char* line: command, not terminated                */
+/*          size_t length: length of line                            */
+/*                                                                   */
+/*      Description:                                                 */
+/*          copies line to the end of the store, then drops the      */
+/*          oldest commands past histsize.                           */
+/*                                                                   */
+/*********************************************************************/
+static int store_entry( const char* line, size_t length )
+{
+    size_t new_size;
+    size_t* offsets;
+    char* text;
+
+    if( store.count == store.capacity )
+    {
+        new_size = ( store.capacity == 0 ? HISTORY_START_COUNT : store.capacity * 2 );
+        if( ( offsets = (size_t*)realloc( store.offsets, new_size * sizeof(size_t) ) ) == NULL )
+        {
+            fprintf( stderr, "Error allocating memory for history.\n" );
+            return FAILURE;
+        }
+        store.offsets = offsets;
+        store.capacity = new_size;
+    }
+
+    if( store.used + length + 1 > store.size )
+    {
+        for( new_size = ( store.size == 0 ? HISTORY_START_SIZE : store.size ); new_size < store.used + length + 1; )
+            new_size *= 2;
+        if( ( text = (char*)realloc( store.text, new_size ) ) == NULL )
+        {
+            fprintf( stderr, "Error allocating memory for history.\n" );
+            return FAILURE;
+        }
+        store.text = text;
+        store.size = new_size;
+    }
+
+    store.offsets[store.count++] = store.used;
+    memcpy( store.text + store.used, line, length );
+    store.text[store.used + length] = '\0';
+    store.used += length + 1;
+
+    drop_entries( (size_t)get_option( OPTION_HISTSIZE ) );
+
+    return SUCCESS;
+} /* end store_entry() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: drop_entries                                  */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          size_t keep: number of commands to keep                  */
+/*                                                                   */
+/*      Description:                                                 */
+/*          drops the oldest commands until keep are left. Their     */
+/*          space is taken back once the dropped outnumber the kept, */
+/*          by moving the kept ones to the front in one go.          */
+/*                                                                   */
+/*********************************************************************/
+static void drop_entries( size_t keep )
+{
+    size_t base, i;
+
+    if( store.count - store.head <= keep )
+        return;
+
+    store.head = store.count - keep;
+
+    if( store.head < store.count - store.head )
+        return;
+
+    base = store.offsets[store.head];
+    memmove( store.text, store.text + base, store.used - base );
+    store.used -= base;
+
+    for( i = store.head; i < store.count; i++ )
+        store.offsets[i - store.head] = store.offsets[i] - base;
+    store.count -= store.head;
+    store.head = 0;
+} /* end drop_entries() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: unwritten_entries                             */
+/*      Return type:   size_t                                        */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          counts the commands kept in memory that were not in the  */
+/*          file at the last history_count(): the ones still in the  */
+/*          ring and the one not logged yet. They are the newest     */
+/*          ones of the store. Without a file, all of them.          */
+/*                                                                   */
+/*********************************************************************/
+static size_t unwritten_entries( void )
+{
+    size_t kept = store.count - store.head, n;
+
+    if( writer.fd == -1 )
+        return kept;
+
+    n = atomic_load_explicit( &writer.head, memory_order_relaxed ) - written + ( pending ? 1 : 0 );
+    return ( n < kept ? n : kept );
+} /* end unwritten_entries() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: drop_last_entry                               */
+/*      Return type:   void                                          */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          forgets the newest command, when it could not be written */
+/*          and so will never have a line of the file.               */
+/*                                                                   */
+/*********************************************************************/
+static void drop_last_entry( void )
+{
+    if( store.count == store.head )
+        return;
+
+    store.count--;
+    store.used = store.offsets[store.count];
+} /* end drop_last_entry() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: wait_for_writer                               */
+/*      Return type:   void                                          */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          runs in the shell before fork(). The child has no writer */
+/*          thread, entries still in the ring at the fork would be   */
+/*          unwritten to it after the shell wrote them, and counted  */
+/*          twice by a builtin such as history. Waits for the ring   */
+/*          to be empty, HISTORY_WAIT_MS at most.                    */
+/*                                                                   */
+/*********************************************************************/
+static void wait_for_writer( void )
+{
+    struct timespec pause = { 0, 1000000L };
+    int waited = 0;
+
+    while( atomic_load_explicit( &writer.tail, memory_order_acquire ) !=
+           atomic_load_explicit( &writer.head, memory_order_relaxed ) && waited++ < HISTORY_WAIT_MS )
+        nanosleep( &pause, NULL );
+} /* end wait_for_writer() */
@@ -4,22 +4,58 @@
 /*          Description:                                             */
 /*              This module provides structures and functions to     */
 /*              store commands so we can keep track of what user     */
-/*              enters.                                              */
+/*              enters. Every command is appended to ~/.j_history    */
+/*              as soon as it finishes, to a file kept open with     */
+/*              O_APPEND, as                                         */
+/*                  <seconds since 1970>\t<exit status>\t<command>   */
+/*              The shell only puts the entry in a lock-free ring,   */
+/*              a writer thread empties it into the file, several    */
+/*              entries per write(), so a slow disk never holds up   */
+/*              the prompt.                                          */
+/*              A command's number is its line in the file, so every */
+/*              shell appending to it agrees on the numbers, even    */
+/*              with other writers in between. The commands of this  */
+/*              shell not in the file yet come after its last line.  */
+/*              The last histsize commands entered are kept in       */
+/*              memory, back to back in one block with the offset of */
+/*              each, and serve those. One copy serves "history", !n */
+/*              and the arrow keys, older commands are read from the */
+/*              file through its index.                              */
 /*                                                                   */
 /*********************************************************************/
 
-#ifndef HISTORY_MODULE_H 
+#ifndef HISTORY_MODULE_H
 #define HISTORY_MODULE_H
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include "string_module.h"
+#include "variable_module.h"
+#include "option_module.h"
+#include "history_file_module.h"
 
 /* macros */
-#define CMD_LIMIT 50
-#define HISTORY_LIMIT 50
+#define HISTORY_START_COUNT 64      /* commands the store starts with   */
+#define HISTORY_START_SIZE 4096     /* bytes the store starts with      */
+#define HISTORY_FILE "/.j_history"  /* in $HOME                         */
+#define HISTORY_RING_SIZE 1024      /* entries waiting to be written,   */
+                                    /* a power of 2                     */
+#define HISTORY_BATCH 64            /* most entries in one write()      */
+#define HISTORY_DRAIN_MS 2000       /* longest wait at exit for the     */
+                                    /* writer to empty the ring         */
+#define HISTORY_WAIT_MS 2000        /* longest wait for the writer      */
+                                    /* before counting the file or fork */
 
 #ifndef FAILURE
     #define FAILURE 0
@@ -28,10 +64,58 @@
     #define SUCCESS 1
 #endif
 
+/* the commands kept in memory, oldest first. The oldest kept */
+/* is at text + offsets[head], dropped commands stay in front  */
+/* of head until there are more of them than kept ones         */
+typedef struct history_store_t
+{
+    char*       text;       /* the commands, each '\0' terminated    */
+    size_t      used;
+    size_t      size;
+    size_t*     offsets;    /* where each command starts in text     */
+    size_t      head;       /* first offset still kept               */
+    size_t      count;      /* offsets used, dropped ones included   */
+    size_t      capacity;
+} history_store;
+
+/* one entry on its way to the file */
+typedef struct history_record_t
+{
+    char*   text;           /* the whole line, '\n' included        */
+    size_t  length;
+    long    sync_every;     /* histsync when the entry was added    */
+} history_record;
+
+/* the file every command is appended to, and the thread that */
+/* writes it. Only the shell moves head and only the writer   */
+/* moves tail, so the ring needs no lock                      */
+typedef struct history_writer_t
+{
+    int                 fd;         /* -1 when the file could not be opened */
+    history_record      ring[HISTORY_RING_SIZE];
+    atomic_size_t       head;       /* next slot the shell fills            */
+    atomic_size_t       tail;       /* next slot the writer empties         */
+    atomic_size_t       writing;    /* tail once the write under way ends   */
+    atomic_int          sleeping;   /* T while the writer waits for entries */
+    atomic_int          stopping;   /* T once the shell is exiting          */
+    int                 running;    /* T when the thread was started        */
+    int                 done;       /* T once the writer emptied the ring   */
+    long                unsynced;   /* written since the last fsync         */
+    pthread_t           thread;
+    pthread_mutex_t     lock;       /* only for sleeping and waking up      */
+    pthread_cond_t      wake;
+    pthread_cond_t      finished;
+} history_writer;
+
 /* function prototypes */
+int     init_history( void );
 int     add_to_history( char* );
+int     log_history( int status );
+long    history_count( void );
 void    print_history( FILE* );
-int     write_history_to_file( void );
+void    print_history_range( FILE* fp, long first, long last );
+int     expand_history( char** line );
+const char* find_history_entry( long n, size_t* length );
 int     free_history( void );
 
 #endif
@@ -0,0 +1,202 @@
+#include "option_module.h"
+
+/* names of the spawn values, in spawn_method order */
+static const char* const spawn_methods[] = { "fork", "vfork", "posix_spawn" };
+
+/* names of the values of an option that is off or on */
+static const char* const switch_values[] = { "off", "on" };
+
+/* every option with its default value, in option_id order */
+static option options[N_OPTIONS] =
+{
+    [OPTION_HISTSYNC] = { "histsync", 0, 0, INT_MAX, NULL,
+                          "fsync the history file every N commands, 0 leaves it to the system" },
+    [OPTION_HISTSIZE] = { "histsize", 50, 1, INT_MAX, NULL,
+                          "commands kept in memory, older ones are read from the history file" },
+    [OPTION_SPAWN] = { "spawn", SPAWN_POSIX, SPAWN_FORK, SPAWN_POSIX, spawn_methods,
+                       "how programs are started, builtins in a pipeline always fork" },
+    [OPTION_PIPEFAIL] = { "pipefail", 0, 0, 1, switch_values,
+                          "a pipeline fails when any command in it fails, not only the last" },
+    [OPTION_PIPESIZE] = { "pipesize", 0, 0, INT_MAX, NULL,
+                          "bytes a pipe holds, e.g. 1M, 0 leaves it to the system" }
+};
+
+/* static function prototypes */
+static option*     find_option( const char* name, size_t length );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: get_option                                    */
+/*      Return type:   long                                          */
+/*      Parameter(s):                                                */
+/*          option_id id: option to read                             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          returns the value of an option, for an option with       */
+/*          named values the index of the name.                      */
+/*                                                                   */
+/*********************************************************************/
+long get_option( option_id id )
+{
+    return options[id].value;
+} /* end get_option() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: set_option                                    */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* setting: "name=value"                        */
+/*                                                                   */
+/*      Description:                                                 */
+/*          changes an option, after checking value is one of its    */
+/*          names or a number in its range.                          */
+/*                                                                   */
+/*********************************************************************/
+int set_option( const char* setting )
+{
+    const char* value = strchr( setting, '=' );
+    option* opt;
+    long number;
+
+    if( value == NULL )
+    {
+        fprintf( stderr, "Error: options are set with \"set name=value\" - %s\n", setting );
+        return FAILURE;
+    }
+
+    if( ( opt = find_option( setting, (size_t)( value - setting ) ) ) == NULL )
+    {
+        fprintf( stderr, "Error: unknown option - %.*s\n", (int)( value - setting ), setting );
+        return FAILURE;
+    }
+    value++;
+
+    if( read_option( (option_id)( opt - options ), value, &number ) == FAILURE )
+        return FAILURE;
+
+    opt->value = number;
+    return SUCCESS;
+} /* end set_option() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: read_option                                   */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          option_id id: option the value is for                    */
+/*          const char* value: one of its names or a number, which   */
+/*                             may end in k, M or G                  */
+/*          long* number: set to the value                           */
+/*                                                                   */
+/*      Description:                                                 */
+/*          checks value is one of the option's names or a number in */
+/*          its range, without changing the option.                  */
+/*                                                                   */
+/*********************************************************************/
+int read_option( option_id id, const char* value, long* number )
+{
+    option* opt = &options[id];
+    char* end;
+    int i, shift = 0;
+
+    if( opt->choices != NULL )
+    {
+        for( i = 0; i <= opt->max; i++ )
+        {
+            if( strcmp( value, opt->choices[i] ) == 0 )
+            {
+                *number = i;
+                return SUCCESS;
+            }
+        }
+
+        fprintf( stderr, "Error: %s can be", opt->name );
+        for( i = 0; i <= opt->max; i++ )
+            fprintf( stderr, "%s %s", ( i == 0 ? "" : ( i == opt->max ? " or" : "," ) ), opt->choices[i] );
+        fprintf( stderr, " - %s\n", value );
+        return FAILURE;
+    }
+
+    *number = strtol( value, &end, 10 );
+
+    // sizes can be given in binary units, 1M is 1048576, after
+    // at least one digit
+    if( end != value && *end != '\0' && end[1] == '\0' )
+    {
+        switch( *end )
+        {
+            case 'k': case 'K': shift = 10; break;
+            case 'M':           shift = 20; break;
+            case 'G':           shift = 30; break;
+        }
+        end += ( shift != 0 );
+    }
+
+    if( *value == '\0' || *end != '\0' || *number < opt->min || *number > ( opt->max >> shift ) )
+    {
+        fprintf( stderr, "Error: %s must be a number from %ld to %ld - %s\n", opt->name, opt->min, opt->max, value );
+        return FAILURE;
+    }
+
+    *number <<= shift;
+    return SUCCESS;
+} /* end read_option() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: print_options                                 */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          FILE* out: where to print                                */
+/*                                                                   */
+/*      Description:                                                 */
+/*          prints every option as the "set" command that gives it   */
+/*          its current value, with what it does.                    */
+/*                                                                   */
+/*********************************************************************/
+void print_options( FILE* out )
+{
+    int i;
+
+    for( i = 0; i < N_OPTIONS; i++ )
+    {
+        if( options[i].choices != NULL )
+            fprintf( out, "set %s=%s\t# %s\n", options[i].name, options[i].choices[options[i].value], options[i].help );
+        else
+            fprintf( out, "set %s=%ld\t# %s\n", options[i].name, options[i].value, options[i].help );
+    }
+} /* end print_options() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_option                                   */
+/*      Return type:   option* (NULL if there is none)               */
+/*      Parameter(s):                                                */
+/*          const char* name: name of the option, not terminated     */
+/*          size_t length: length of name                            */
+/*                                                                   */
+/*********************************************************************/
+static option* find_option( const char* name, size_t length )
+{
+    int i;
+
+    for( i = 0; i < N_OPTIONS; i++ )
+    {
+        if( strncmp( options[i].name, name, length ) == 0 && options[i].name[length] == '\0' )
+            return &options[i];
+    }
+
+    return NULL;
+} /* end find_option() */
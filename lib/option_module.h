@@ -0,0 +1,65 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: option_module.h                             */
+/*          Description:                                             */
+/*              This module keeps the settings that change how the   */
+/*              shell behaves while it runs, set with the "set"      */
+/*              builtin as "set name=value". Every option is a       */
+/*              number, or one of a few named values.                */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef OPTION_MODULE_H
+#define OPTION_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "string_module.h"
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* every option, index in the option table */
+typedef enum option_id_t
+{
+    OPTION_HISTSYNC,
+    OPTION_HISTSIZE,
+    OPTION_SPAWN,
+    OPTION_PIPEFAIL,
+    OPTION_PIPESIZE,
+    N_OPTIONS
+} option_id;
+
+/* values of OPTION_SPAWN, how programs are started */
+typedef enum spawn_method_t
+{
+    SPAWN_FORK,
+    SPAWN_VFORK,
+    SPAWN_POSIX
+} spawn_method;
+
+/* one option and its current value */
+typedef struct option_t
+{
+    const char*         name;
+    long                value;
+    long                min;
+    long                max;
+    const char* const*  choices;    /* name of each value, NULL when */
+                                    /* the value is a plain number   */
+    const char*         help;
+} option;
+
+/* function prototypes */
+long    get_option( option_id id );
+int     set_option( const char* setting );
+int     read_option( option_id id, const char* value, long* number );
+void    print_options( FILE* out );
+
+#endif
@@ -0,0 +1,301 @@
+#include "parse_module.h"
+
+/* name of every builtin */
+static const struct
+{
+    const char*     name;
+    builtin_id      id;
+    int             pure;   /* only prints, so $(...) can run it in the shell */
+} builtins[] =
+{
+    { "history", BUILTIN_HISTORY, T },
+    { "alias", BUILTIN_ALIAS, F },
+    { "unalias", BUILTIN_UNALIAS, F },
+    { "cd", BUILTIN_CD, F },
+    { "cache", BUILTIN_CACHE, T },
+    { "export", BUILTIN_EXPORT, F },
+    { "unset", BUILTIN_UNSET, F },
+    { "echo", BUILTIN_ECHO, T },
+    { "pwd", BUILTIN_PWD, T },
+    { "set", BUILTIN_SET, F },
+    { "hash", BUILTIN_HASH, F }
+};
+
+/* static function prototypes */
+static builtin_id  find_builtin( const char* name );
+static int         parse_redirect( word_vector* words, int* index, redirect* r );
+static int         read_descriptor( const char* text, const char* op, int* fd );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: parse_commands                                */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          word_vector* words: words of the command line            */
+/*          command_list* list: where the commands are stored        */
+/*                                                                   */
+/*      Description:                                                 */
+/*          Goes through the words once, splitting them into         */
+/*          pipelines (at ; && ||), commands (at |), arguments and   */
+/*          redirects. Builtins are recognized here so nothing later */
+/*          has to compare strings. Every array is allocated from    */
+/*          line_arena, sized for the worst case of one entry per    */
+/*          word.                                                    */
+/*                                                                   */
+/*********************************************************************/
+int parse_commands( word_vector* words, command_list* list )
+{
+    int i, n = words->count;
+    token_kind kind, last = TOKEN_SEMICOLON;
+    pipeline* pl = NULL;
+    command* cmd = NULL;
+
+    list->words = words;
+    list->n_pipelines = list->n_commands = list->n_args = list->n_redirects = 0;
+    list->expanded = NULL;
+    list->pipelines = (pipeline*)arena_alloc( &line_arena, ( n + 1 ) * sizeof(pipeline) );
+    list->commands = (command*)arena_alloc( &line_arena, ( n + 1 ) * sizeof(command) );
+    list->args = (int*)arena_alloc( &line_arena, ( n + 1 ) * sizeof(int) );
+    list->redirects = (redirect*)arena_alloc( &line_arena, ( n + 1 ) * sizeof(redirect) );
+
+    if( list->pipelines == NULL || list->commands == NULL || list->args == NULL || list->redirects == NULL )
+    {
+        fprintf( stderr, "Error: could not allocate memory to parse command\n" );
+        return FAILURE;
+    }
+
+    for( i = 0; i < n; i++ )
+    {
+        kind = words->kinds[i];
+
+        // operators that separate commands need a command before them
+        if( cmd == NULL && kind != TOKEN_WORD && kind < TOKEN_REDIRECT_IN )
+        {
+            fprintf( stderr, "Error: syntax error near '%s'\n", words->words[i] );
+            return FAILURE;
+        }
+
+        // start a new pipeline
+        if( pl == NULL )
+        {
+            pl = &list->pipelines[list->n_pipelines++];
+            pl->first_command = list->n_commands;
+            pl->n_commands = 0;
+            pl->connector = TOKEN_SEMICOLON;
+            pl->size_word = -1;
+        }
+
+        // start a new command
+        if( cmd == NULL )
+        {
+            cmd = &list->commands[list->n_commands++];
+            cmd->first_assign = cmd->first_arg = list->n_args;
+            cmd->first_redirect = list->n_redirects;
+            cmd->n_assigns = cmd->argc = cmd->n_redirects = 0;
+            cmd->builtin = BUILTIN_NONE;
+            pl->n_commands++;
+        }
+
+        switch( kind )
+        {
+            case TOKEN_WORD:
+                // "pipesize=SIZE" as the first word of a pipeline
+                // sizes its pipes, it is not a variable
+                if( pl->n_commands == 1 && cmd->argc == 0 && cmd->n_assigns == 0 && pl->size_word == -1 &&
+                    strncmp( words->words[i], PIPE_SIZE_PREFIX, strlen( PIPE_SIZE_PREFIX ) ) == 0 )
+                {
+                    pl->size_word = i;
+                    break;
+                }
+
+                // "NAME=value" before the program sets a variable,
+                // the arguments start after the last one
+                if( cmd->argc == 0 && is_assignment( words->words[i] ) )
+                {
+                    list->args[list->n_args++] = i;
+                    cmd->n_assigns++;
+                    cmd->first_arg++;
+                    break;
+                }
+
+                // the first word names the program
+                if( cmd->argc == 0 )
+                    cmd->builtin = find_builtin( words->words[i] );
+
+                list->args[list->n_args++] = i;
+                cmd->argc++;
+                break;
+            case TOKEN_PIPE:
+                cmd = NULL;
+                break;
+            case TOKEN_AND:
+            case TOKEN_OR:
+            case TOKEN_SEMICOLON:
+                pl->connector = kind;
+                pl = NULL;
+                cmd = NULL;
+                break;
+            case TOKEN_BACKGROUND:
+                fprintf( stderr, "Error: running programs in the background is not supported\n" );
+                return FAILURE;
+            default:
+                if( parse_redirect( words, &i, &list->redirects[list->n_redirects++] ) == FAILURE )
+                    return FAILURE;
+                cmd->n_redirects++;
+                break;
+        }
+        last = kind;
+    }
+
+    // line cannot end waiting for another command, except after ;
+    if( n > 0 && cmd == NULL && last != TOKEN_SEMICOLON )
+    {
+        fprintf( stderr, "Error: syntax error, command missing after '%s'\n", words->words[n - 1] );
+        return FAILURE;
+    }
+
+    return SUCCESS;
+} /* end parse_commands() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: builtin_is_pure                               */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          builtin_id id: builtin to check                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          a pure builtin only prints and never changes the shell,  */
+/*          so running it in the shell instead of in a child gives   */
+/*          the same result.                                         */
+/*                                                                   */
+/*********************************************************************/
+int builtin_is_pure( builtin_id id )
+{
+    size_t i;
+
+    for( i = 0; i < sizeof( builtins ) / sizeof( builtins[0] ); i++ )
+    {
+        if( builtins[i].id == id )
+            return builtins[i].pure;
+    }
+
+    return F;
+} /* end builtin_is_pure() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_builtin                                  */
+/*      Return type:   builtin_id                                    */
+/*      Parameter(s):                                                */
+/*          const char* name: name of the program                    */
+/*                                                                   */
+/*********************************************************************/
+static builtin_id find_builtin( const char* name )
+{
+    size_t i;
+
+    for( i = 0; i < sizeof( builtins ) / sizeof( builtins[0] ); i++ )
+    {
+        if( strcmp( builtins[i].name, name ) == 0 )
+            return builtins[i].id;
+    }
+
+    return BUILTIN_NONE;
+} /* end find_builtin() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: parse_redirect                                */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          word_vector* words: words of the command line            */
+/*          int* index: index of the redirect operator, moved past   */
+/*                      the file name when there is one              */
+/*          redirect* r: where the redirect is stored                */
+/*                                                                   */
+/*      Description:                                                 */
+/*          reads the descriptor in front of the operator (if any)   */
+/*          and either the descriptor after >& / <& or the file      */
+/*          name in the next word.                                   */
+/*                                                                   */
+/*********************************************************************/
+static int parse_redirect( word_vector* words, int* index, redirect* r )
+{
+    char* op = words->words[*index], * dup;
+
+    r->type = words->kinds[*index];
+
+    // descriptor in front, defaults to stdin for < and stdout for >
+    if( isdigit( (unsigned char)op[0] ) )
+    {
+        if( read_descriptor( op, op, &r->fd ) == FAILURE )
+            return FAILURE;
+    }
+    else
+        r->fd = ( r->type == TOKEN_REDIRECT_IN || r->type == TOKEN_DUP_IN ? 0 : 1 );
+
+    // >&N and <&N carry the descriptor to copy
+    if( r->type == TOKEN_DUP_IN || r->type == TOKEN_DUP_OUT )
+    {
+        dup = strchr( op, '&' ) + 1;
+        if( !isdigit( (unsigned char)*dup ) )
+        {
+            fprintf( stderr, "Error: syntax error, descriptor missing after '%s'\n", op );
+            return FAILURE;
+        }
+        return read_descriptor( dup, op, &r->target );
+    }
+
+    // everything else needs a file name
+    if( *index + 1 >= words->count || words->kinds[*index + 1] != TOKEN_WORD )
+    {
+        fprintf( stderr, "Error: syntax error, file name missing after '%s'\n", op );
+        return FAILURE;
+    }
+    r->target = ++(*index);
+
+    return SUCCESS;
+} /* end parse_redirect() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: read_descriptor                               */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* text: digits of the descriptor               */
+/*          const char* op: whole redirect, for the error message    */
+/*          int* fd: set to the descriptor                           */
+/*                                                                   */
+/*      Description:                                                 */
+/*          reads a descriptor number, which must be from 0 to       */
+/*          REDIRECT_MAX_FD.                                         */
+/*                                                                   */
+/*********************************************************************/
+static int read_descriptor( const char* text, const char* op, int* fd )
+{
+    long number;
+
+    errno = 0;
+    number = strtol( text, NULL, 10 );
+
+    if( errno != 0 || number < 0 || number > REDIRECT_MAX_FD )
+    {
+        fprintf( stderr, "Error: syntax error, descriptor out of range in '%s'\n", op );
+        return FAILURE;
+    }
+
+    *fd = (int)number;
+    return SUCCESS;
+} /* end read_descriptor() */
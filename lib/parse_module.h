@@ -0,0 +1,111 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: parse_module.h                              */
+/*          Description:                                             */
+/*              This module turns the words of a command line into   */
+/*              a list of pipelines, each made of commands with      */
+/*              their arguments and redirects, in a single pass.     */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef PARSE_MODULE_H
+#define PARSE_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "string_module.h"
+#include "arena_module.h"
+#include "variable_module.h"
+
+/* macros */
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+#define PIPE_SIZE_PREFIX "pipesize="    /* sizes the pipes of one pipeline */
+#define REDIRECT_MAX_FD 1023            /* highest descriptor a redirect   */
+                                        /* can name                        */
+
+/* commands the shell runs itself */
+typedef enum builtin_id_t
+{
+    BUILTIN_NONE,
+    BUILTIN_HISTORY,
+    BUILTIN_ALIAS,
+    BUILTIN_UNALIAS,
+    BUILTIN_CD,
+    BUILTIN_CACHE,
+    BUILTIN_EXPORT,
+    BUILTIN_UNSET,
+    BUILTIN_ECHO,
+    BUILTIN_PWD,
+    BUILTIN_SET,
+    BUILTIN_HASH
+} builtin_id;
+
+/* one redirect of a command, e.g. 2>>log */
+typedef struct redirect_t
+{
+    token_kind  type;       /* TOKEN_REDIRECT_IN ... TOKEN_DUP_OUT        */
+    int         fd;         /* descriptor being redirected                */
+    int         target;     /* index of the file name in the words, or    */
+                            /* the descriptor to copy for TOKEN_DUP_*     */
+} redirect;
+
+/* one program and its arguments */
+typedef struct command_t
+{
+    int         first_assign;   /* "NAME=value" words before the       */
+    int         n_assigns;      /* program, index in command_list.args */
+    int         first_arg;      /* index in command_list.args          */
+    int         argc;
+    int         first_redirect; /* index in command_list.redirects     */
+    int         n_redirects;
+    builtin_id  builtin;
+} command;
+
+/* arguments of a command once they are expanded */
+typedef struct arguments_t
+{
+    char**      argv;           /* NULL terminated                     */
+    int         argc;
+} arguments;
+
+/* commands connected by pipes */
+typedef struct pipeline_t
+{
+    int         first_command;  /* index in command_list.commands      */
+    int         n_commands;
+    token_kind  connector;      /* TOKEN_SEMICOLON, TOKEN_AND or       */
+                                /* TOKEN_OR, how the next one is run   */
+    int         size_word;      /* index of "pipesize=SIZE" in front   */
+                                /* of the pipeline in words, or -1     */
+} pipeline;
+
+/* everything on one command line, indices refer to words */
+typedef struct command_list_t
+{
+    word_vector*    words;
+    pipeline*       pipelines;
+    int             n_pipelines;
+    command*        commands;
+    int             n_commands;
+    int*            args;       /* index of each argument in words     */
+    int             n_args;
+    redirect*       redirects;
+    int             n_redirects;
+    arguments*      expanded;   /* of each command, NULL until         */
+                                /* expand_pipeline() runs              */
+} command_list;
+
+/* function prototypes */
+int     parse_commands( word_vector* words, command_list* list );
+int     builtin_is_pure( builtin_id id );
+
+#endif
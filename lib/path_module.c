@@ -0,0 +1,295 @@
+#include "path_module.h"
+
+/* static function prototypes */
+static int         search_path( const char* name, const char* dirs, char* path, int* relative );
+static program*    store_program( const char* name, size_t length, uint64_t hash, const char* path );
+static int         match_program( const void* entry, const char* name, size_t length );
+static int         use_search_path( const char* dirs );
+
+/* globals */
+static program_table    table = { { NULL, NULL, 0, 0, PATH_START_SIZE, "program", match_program }, NULL };
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_in_path                                  */
+/*      Return type:   const char* - path of the program, NULL if    */
+/*                     none                                          */
+/*      Parameter(s):                                                */
+/*          const char* name: program name, without a '/'            */
+/*                                                                   */
+/*      Description:                                                 */
+/*          returns where name was found before, after checking it   */
+/*          is still there, or searches $PATH for it and remembers   */
+/*          it. A program found through a relative directory, e.g.   */
+/*          ".", is not remembered, the answer changes with cd. The  */
+/*          path is good until the next call.                        */
+/*                                                                   */
+/*********************************************************************/
+const char* find_in_path( const char* name )
+{
+    static char found[PATH_MAX];
+    const char* dirs = get_variable( "PATH" );
+    size_t length = strlen( name );
+    uint64_t hash = hash_bytes( name, length );
+    program* p;
+    int relative;
+
+    if( dirs == NULL )
+        dirs = DEFAULT_PATH;
+
+    if( use_search_path( dirs ) == FAILURE )
+        return NULL;
+
+    if( ( p = (program*)table_get( &table.programs, name, length, hash ) ) != NULL )
+    {
+        if( access( p->path, X_OK ) == 0 )
+        {
+            p->hits++;
+            return p->path;
+        }
+
+        // it moved, whatever else was found may have too
+        clear_programs();
+        if( use_search_path( dirs ) == FAILURE )
+            return NULL;
+    }
+
+    if( search_path( name, dirs, found, &relative ) == FAILURE )
+        return NULL;
+
+    if( relative || ( p = store_program( name, length, hash, found ) ) == NULL )
+        return found;
+
+    p->hits++;
+    return p->path;
+} /* end find_in_path() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: remember_program                              */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* name: program name                           */
+/*                                                                   */
+/*      Description:                                                 */
+/*          searches $PATH for name again and remembers where it is, */
+/*          for "hash name".                                         */
+/*                                                                   */
+/*********************************************************************/
+int remember_program( const char* name )
+{
+    char found[PATH_MAX];
+    const char* dirs = get_variable( "PATH" );
+    size_t length = strlen( name );
+    int relative;
+
+    if( dirs == NULL )
+        dirs = DEFAULT_PATH;
+
+    if( strchr( name, '/' ) != NULL || use_search_path( dirs ) == FAILURE ||
+        search_path( name, dirs, found, &relative ) == FAILURE )
+    {
+        fprintf( stderr, "Error: hash: %s not found\n", name );
+        return FAILURE;
+    }
+
+    if( relative )
+        return SUCCESS;
+
+    return ( store_program( name, length, hash_bytes( name, length ), found ) == NULL ? FAILURE : SUCCESS );
+} /* end remember_program() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: print_programs                                */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          FILE* out: where to print                                */
+/*                                                                   */
+/*      Description:                                                 */
+/*          prints every program remembered with the number of times */
+/*          it was run, as "hash" shows them.                        */
+/*                                                                   */
+/*********************************************************************/
+void print_programs( FILE* out )
+{
+    program* p;
+    size_t i;
+
+    if( table.programs.count == 0 )
+        return;
+
+    fprintf( out, "hits\tcommand\n" );
+    for( i = 0; i < table.programs.capacity; i++ )
+    {
+        if( ( p = (program*)table.programs.slots[i] ) != NULL )
+            fprintf( out, "%4lu\t%s\n", p->hits, p->path );
+    }
+} /* end print_programs() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: clear_programs                                */
+/*      Return type:   void                                          */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          forgets every program, for "hash -r" and on exit.        */
+/*                                                                   */
+/*********************************************************************/
+void clear_programs( void )
+{
+    table_free( &table.programs );
+    free( table.search_path );
+    table.search_path = NULL;
+} /* end clear_programs() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: use_search_path                               */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* dirs: the current $PATH                      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          empties the table when dirs is not the $PATH it was      */
+/*          filled from.                                             */
+/*                                                                   */
+/*********************************************************************/
+static int use_search_path( const char* dirs )
+{
+    if( table.search_path != NULL && strcmp( table.search_path, dirs ) == 0 )
+        return SUCCESS;
+
+    clear_programs();
+
+    if( ( table.search_path = strdup( dirs ) ) == NULL )
+    {
+        fprintf( stderr, "Error: could not allocate memory for $PATH\n" );
+        return FAILURE;
+    }
+
+    return SUCCESS;
+} /* end use_search_path() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: search_path                                   */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* name: program name                           */
+/*          const char* dirs: directories separated by ':'           */
+/*          char* path: PATH_MAX bytes, set to where name is         */
+/*          int* relative: set to T when the directory is relative   */
+/*                                                                   */
+/*      Description:                                                 */
+/*          looks for an executable file called name in each         */
+/*          directory of dirs, in order, the way execvp() does.      */
+/*                                                                   */
+/*********************************************************************/
+static int search_path( const char* name, const char* dirs, char* path, int* relative )
+{
+    const char* end;
+    struct stat st;
+    int dir_len, length;
+
+    for( ; ; dirs = end + 1 )
+    {
+        if( ( end = strchr( dirs, ':' ) ) == NULL )
+            end = dirs + strlen( dirs );
+        dir_len = (int)( end - dirs );
+
+        // an empty entry means the current directory
+        if( dir_len == 0 )
+            length = snprintf( path, PATH_MAX, "./%s", name );
+        else
+            length = snprintf( path, PATH_MAX, "%.*s/%s", dir_len, dirs, name );
+
+        if( length < PATH_MAX && stat( path, &st ) == 0 && S_ISREG( st.st_mode ) &&
+            access( path, X_OK ) == 0 )
+        {
+            *relative = ( dir_len == 0 || *dirs != '/' );
+            return SUCCESS;
+        }
+
+        if( *end == '\0' )
+            break;
+    }
+
+    return FAILURE;
+} /* end search_path() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: store_program                                 */
+/*      Return type:   program* - NULL on failure                    */
+/*      Parameter(s):                                                */
+/*          const char* name: program name, not terminated           */
+/*          size_t length: length of name                            */
+/*          uint64_t hash: hash of name                              */
+/*          const char* path: where it was found                     */
+/*                                                                   */
+/*      Description:                                                 */
+/*          adds a program to the table or replaces where it is. The */
+/*          name and path are kept in the same allocation.           */
+/*                                                                   */
+/*********************************************************************/
+static program* store_program( const char* name, size_t length, uint64_t hash, const char* path )
+{
+    size_t path_len = strlen( path );
+    program* p;
+    void* old;
+
+    if( ( p = (program*)malloc( sizeof(program) + length + path_len + 2 ) ) == NULL )
+    {
+        fprintf( stderr, "Error: could not allocate memory for program %.*s\n", (int)length, name );
+        return NULL;
+    }
+
+    p->name = (char*)( p + 1 );
+    memcpy( p->name, name, length );
+    p->name[length] = '\0';
+    p->path = p->name + length + 1;
+    memcpy( p->path, path, path_len + 1 );
+    p->name_len = length;
+    p->hits = 0;
+
+    if( table_put( &table.programs, p, p->name, length, hash, &old ) == FAILURE )
+    {
+        free( p );
+        return NULL;
+    }
+    free( old );
+
+    return p;
+} /* end store_program() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: match_program                                 */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          const void* entry: program in the table                  */
+/*          const char* name: name to find, not terminated           */
+/*          size_t length: length of name                            */
+/*                                                                   */
+/*********************************************************************/
+static int match_program( const void* entry, const char* name, size_t length )
+{
+    const program* p = (const program*)entry;
+
+    return ( p->name_len == length && memcmp( p->name, name, length ) == 0 );
+} /* end match_program() */
@@ -0,0 +1,60 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: path_module.h                               */
+/*          Description:                                             */
+/*              This module finds programs in $PATH and remembers    */
+/*              where, in an open addressing hash table, so a        */
+/*              program is only searched for the first time it is    */
+/*              run. The table is emptied when $PATH changes, by     */
+/*              "hash -r", or when a program is no longer where it   */
+/*              was found.                                           */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef PATH_MODULE_H
+#define PATH_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "string_module.h"
+#include "variable_module.h"
+#include "table_module.h"
+
+#define PATH_START_SIZE 64                  /* slots, must be a power of 2    */
+#define DEFAULT_PATH "/usr/bin:/bin"        /* searched when $PATH is not set */
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* one program found, the name and path follow it in memory */
+typedef struct program_t
+{
+    char*           name;
+    char*           path;
+    size_t          name_len;
+    unsigned long   hits;       /* times it was run                 */
+} program;
+
+/* structure to hold every program found */
+typedef struct program_table_t
+{
+    hash_table  programs;       /* keyed by name                    */
+    char*       search_path;    /* $PATH the programs were found in */
+} program_table;
+
+/* prototypes */
+const char* find_in_path( const char* name );
+int         remember_program( const char* name );
+void        print_programs( FILE* out );
+void        clear_programs( void );
+
+#endif
@@ -0,0 +1,288 @@
+#include "scan_module.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define SCAN_X86 1
+#endif
+
+/* a kernel classifies one block of bytes */
+typedef struct scan_kernel_t
+{
+    const char*     name;
+    int             width;
+    void            (*classify)( const char* block, scan_masks* masks );
+} scan_kernel;
+
+/* static function prototypes */
+static void    classify_scalar( const char* block, scan_masks* masks );
+#ifdef SCAN_X86
+static void    classify_sse2( const char* block, scan_masks* masks );
+static void    classify_avx2( const char* block, scan_masks* masks );
+#endif
+
+/* kernels we can run, best last */
+static const scan_kernel kernels[] =
+{
+    { "scalar", 8, classify_scalar },
+#ifdef SCAN_X86
+    { "sse2", 16, classify_sse2 },
+    { "avx2", 32, classify_avx2 },
+#endif
+};
+
+/* kernel in use, picked by scan_init() */
+static const scan_kernel* kernel = &kernels[0];
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: scan_init                                     */
+/*      Return type:   none                                          */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          picks the widest kernel the CPU supports.                */
+/*                                                                   */
+/*********************************************************************/
+void scan_init( void )
+{
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+
+    if( __builtin_cpu_supports( "avx2" ) )
+        scan_select( "avx2" );
+    else if( __builtin_cpu_supports( "sse2" ) )
+        scan_select( "sse2" );
+    else
+#endif
+        scan_select( "scalar" );
+} /* end scan_init() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: scan_select                                   */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* name: "scalar", "sse2" or "avx2"             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          forces a kernel, used to compare them against each       */
+/*          other. The caller must know the CPU supports it.         */
+/*                                                                   */
+/*********************************************************************/
+int scan_select( const char* name )
+{
+    size_t i;
+
+    for( i = 0; i < sizeof( kernels ) / sizeof( kernels[0] ); i++ )
+    {
+        if( strcmp( kernels[i].name, name ) == 0 )
+        {
+            kernel = &kernels[i];
+            return SUCCESS;
+        }
+    }
+
+    fprintf( stderr, "Error: unknown scan kernel - %s\n", name );
+    return FAILURE;
+} /* end scan_select() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: scan_kernel_name                              */
+/*      Return type:   const char*                                   */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*********************************************************************/
+const char* scan_kernel_name( void )
+{
+    return kernel->name;
+} /* end scan_kernel_name() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: scan_to_boundary                              */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          const char* line: line being tokenized                   */
+/*          int pos: where to start looking                          */
+/*          int len: length of line                                  */
+/*                                                                   */
+/*      Description:                                                 */
+/*          returns the index of the first whitespace, quote,        */
+/*          backslash, operator, '$' or '`' at or after pos, or len  */
+/*          if there is none. Whole blocks are classified by the     */
+/*          kernel, the tail that does not fill a block is checked   */
+/*          one byte at a time so we never read past the end of      */
+/*          line.                                                    */
+/*                                                                   */
+/*********************************************************************/
+int scan_to_boundary( const char* line, int pos, int len )
+{
+    scan_masks masks;
+    unsigned int hits;
+
+    // whole blocks
+    for( ; pos + kernel->width <= len; pos += kernel->width )
+    {
+        kernel->classify( &line[pos], &masks );
+
+        if( ( hits = masks.space | masks.quote | masks.special ) != 0 )
+            return pos + __builtin_ctz( hits );
+    }
+
+    // what is left over
+    for( ; pos < len; pos++ )
+    {
+        if( scan_is_boundary( line[pos] ) )
+            return pos;
+    }
+
+    return len;
+} /* end scan_to_boundary() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: scan_is_boundary                              */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          const char c: character being tested                     */
+/*                                                                   */
+/*      Description:                                                 */
+/*          scalar version of the test every kernel performs.        */
+/*                                                                   */
+/*********************************************************************/
+int scan_is_boundary( const char c )
+{
+    return ( c == ' ' || ( c >= '\t' && c <= '\r' ) ||
+             c == '\"' || c == '\'' || c == '\\' ||
+             c == '|' || c == '&' || c == ';' ||
+             c == '<' || c == '>' ||
+             c == '$' || c == '`'
+           );
+} /* end scan_is_boundary() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: classify_scalar                               */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          const char* block: 8 bytes to classify                   */
+/*          scan_masks* masks: where the classes are stored          */
+/*                                                                   */
+/*********************************************************************/
+static void classify_scalar( const char* block, scan_masks* masks )
+{
+    int i;
+    char c;
+
+    masks->space = masks->quote = masks->special = 0;
+
+    for( i = 0; i < 8; i++ )
+    {
+        c = block[i];
+
+        if( c == ' ' || ( c >= '\t' && c <= '\r' ) )
+            masks->space |= 1u << i;
+        else if( c == '\"' || c == '\'' )
+            masks->quote |= 1u << i;
+        else if( scan_is_boundary( c ) )
+            masks->special |= 1u << i;
+    }
+} /* end classify_scalar() */
+
+
+#ifdef SCAN_X86
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: classify_sse2                                 */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          const char* block: 16 bytes to classify                  */
+/*          scan_masks* masks: where the classes are stored          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          '\t' - '\r' is tested by subtracting '\t' and checking   */
+/*          the result is at most 4 as an unsigned byte.             */
+/*                                                                   */
+/*********************************************************************/
+__attribute__(( target( "sse2" ) ))
+static void classify_sse2( const char* block, scan_masks* masks )
+{
+    __m128i v = _mm_loadu_si128( (const __m128i*)block );
+    __m128i ctrl = _mm_sub_epi8( v, _mm_set1_epi8( '\t' ) );
+    __m128i space, quote, special;
+
+    space = _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( ' ' ) ),
+                          _mm_cmpeq_epi8( _mm_min_epu8( ctrl, _mm_set1_epi8( 4 ) ), ctrl ) );
+
+    quote = _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( '\"' ) ),
+                          _mm_cmpeq_epi8( v, _mm_set1_epi8( '\'' ) ) );
+
+    special = _mm_or_si128( _mm_cmpeq_epi8( v, _mm_set1_epi8( '\\' ) ),
+                            _mm_cmpeq_epi8( v, _mm_set1_epi8( '|' ) ) );
+    special = _mm_or_si128( special, _mm_cmpeq_epi8( v, _mm_set1_epi8( '&' ) ) );
+    special = _mm_or_si128( special, _mm_cmpeq_epi8( v, _mm_set1_epi8( ';' ) ) );
+    special = _mm_or_si128( special, _mm_cmpeq_epi8( v, _mm_set1_epi8( '<' ) ) );
+    special = _mm_or_si128( special, _mm_cmpeq_epi8( v, _mm_set1_epi8( '>' ) ) );
+    special = _mm_or_si128( special, _mm_cmpeq_epi8( v, _mm_set1_epi8( '$' ) ) );
+    special = _mm_or_si128( special, _mm_cmpeq_epi8( v, _mm_set1_epi8( '`' ) ) );
+
+    masks->space = (unsigned int)_mm_movemask_epi8( space );
+    masks->quote = (unsigned int)_mm_movemask_epi8( quote );
+    masks->special = (unsigned int)_mm_movemask_epi8( special );
+} /* end classify_sse2() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: classify_avx2                                 */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          const char* block: 32 bytes to classify                  */
+/*          scan_masks* masks: where the classes are stored          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          same as classify_sse2() on twice as many bytes.          */
+/*                                                                   */
+/*********************************************************************/
+__attribute__(( target( "avx2" ) ))
+static void classify_avx2( const char* block, scan_masks* masks )
+{
+    __m256i v = _mm256_loadu_si256( (const __m256i*)block );
+    __m256i ctrl = _mm256_sub_epi8( v, _mm256_set1_epi8( '\t' ) );
+    __m256i space, quote, special;
+
+    space = _mm256_or_si256( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( ' ' ) ),
+                             _mm256_cmpeq_epi8( _mm256_min_epu8( ctrl, _mm256_set1_epi8( 4 ) ), ctrl ) );
+
+    quote = _mm256_or_si256( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '\"' ) ),
+                             _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '\'' ) ) );
+
+    special = _mm256_or_si256( _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '\\' ) ),
+                               _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '|' ) ) );
+    special = _mm256_or_si256( special, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '&' ) ) );
+    special = _mm256_or_si256( special, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( ';' ) ) );
+    special = _mm256_or_si256( special, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '<' ) ) );
+    special = _mm256_or_si256( special, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '>' ) ) );
+    special = _mm256_or_si256( special, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '$' ) ) );
+    special = _mm256_or_si256( special, _mm256_cmpeq_epi8( v, _mm256_set1_epi8( '`' ) ) );
+
+    masks->space = (unsigned int)_mm256_movemask_epi8( space );
+    masks->quote = (unsigned int)_mm256_movemask_epi8( quote );
+    masks->special = (unsigned int)_mm256_movemask_epi8( special );
+} /* end classify_avx2() */
+
+#endif
@@ -0,0 +1,42 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: scan_module.h                               */
+/*          Description:                                             */
+/*              This module finds the next word boundary in a line   */
+/*              (whitespace, quote, backslash, operator, $ or `)     */
+/*              many bytes at a time. An SSE2 or AVX2 kernel is      */
+/*              picked when the CPU supports it, with a scalar       */
+/*              kernel as fallback.                                  */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef SCAN_MODULE_H
+#define SCAN_MODULE_H
+
+#include <stdio.h>
+#include <string.h>
+
+/* macros */
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* classes of one block of bytes, bit i is set when byte i is in it */
+typedef struct scan_masks_t
+{
+    unsigned int    space;
+    unsigned int    quote;
+    unsigned int    special;    /* backslash, operators, $ and ` */
+} scan_masks;
+
+/* function prototypes */
+void        scan_init( void );
+int         scan_select( const char* name );
+const char* scan_kernel_name( void );
+int         scan_to_boundary( const char* line, int pos, int len );
+int         scan_is_boundary( const char c );
+
+#endif
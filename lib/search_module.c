@@ -0,0 +1,631 @@
+#include "search_module.h"
+
+/* globals */
+static search_builder builder;
+static long     browsing = 0;       /* command on the line, 0 while it */
+                                    /* is the one being typed          */
+static char*    draft = NULL;       /* the line being typed, kept      */
+                                    /* while browsing                  */
+
+/* static function prototypes */
+static int          start_line( void );
+static int          previous_key( int count, int key );
+static int          next_key( int count, int key );
+static int          search_key( int count, int key );
+static int          show_entry( long n, const char* text, size_t length );
+static void*        build_index( void* arg );
+static long         index_commands( const char* map, size_t size, uint32_t* last,
+                                    uint32_t* slots, uint32_t* entries );
+static long         search_index_for( const char* text, size_t length, long before );
+static int          has_entry( uint32_t bucket, uint32_t n );
+static const char*  find_text( const char* entry, size_t entry_length,
+                               const char* text, size_t length );
+static uint32_t     trigram_bucket( const char* p );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: init_search                                   */
+/*      Return type:   void                                          */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          binds the up and down arrows (and Ctrl-P, Ctrl-N) in     */
+/*          readline to the shell's history, and Ctrl-R to the       */
+/*          history search. Nothing is indexed until it is first     */
+/*          used.                                                    */
+/*                                                                   */
+/*********************************************************************/
+void init_search( void )
+{
+    rl_startup_hook = start_line;
+
+    rl_bind_key( CTRL( 'p' ), previous_key );
+    rl_bind_key( CTRL( 'n' ), next_key );
+    rl_bind_keyseq( "\\e[A", previous_key );
+    rl_bind_keyseq( "\\e[B", next_key );
+    rl_bind_keyseq( "\\eOA", previous_key );
+    rl_bind_keyseq( "\\eOB", next_key );
+    rl_bind_key( CTRL( 'r' ), search_key );
+} /* end init_search() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: search_history                                */
+/*      Return type:   long - number of the command, 0 if none       */
+/*      Parameter(s):                                                */
+/*          const char* text: what to look for, not terminated       */
+/*          size_t length: length of text                            */
+/*          long before: only commands older than this one are       */
+/*                       looked at                                   */
+/*                                                                   */
+/*      Description:                                                 */
+/*          finds the newest command before "before" that contains   */
+/*          text. The first call starts the thread that indexes the  */
+/*          file, commands it has not indexed are scanned one by     */
+/*          one.                                                     */
+/*                                                                   */
+/*********************************************************************/
+long search_history( const char* text, size_t length, long before )
+{
+    const char* home, * entry;
+    size_t entry_length;
+    long n, count, indexed = 0;
+
+    if( !builder.started )
+    {
+        home = get_variable( "HOME" );
+        snprintf( builder.path, sizeof(builder.path), "%s%s", ( home == NULL ? "." : home ), HISTORY_FILE );
+        builder.started = ( pthread_create( &builder.thread, NULL, build_index, NULL ) == 0 );
+    }
+
+    if( length == 0 )
+        return 0;
+
+    // so the commands written since are found in the file
+    count = history_count();
+
+    // the index numbers the lines of the file it was built from,
+    // it is of no use once that file was replaced or cut short
+    if( atomic_load( &builder.ready ) && builder.index.inode == history_file_inode() &&
+        builder.index.count <= history_file_count() )
+        indexed = (long)builder.index.count;
+    if( before > count + 1 )
+        before = count + 1;
+
+    // what the shell added since the index was built, and all of
+    // it while the index is not ready or too short to be used
+    for( n = before - 1; n > 0 && ( n > indexed || length < 3 ); n-- )
+    {
+        if( ( entry = find_history_entry( n, &entry_length ) ) != NULL &&
+            find_text( entry, entry_length, text, length ) != NULL )
+            return n;
+    }
+
+    if( n == 0 )
+        return 0;
+
+    return search_index_for( text, length, n + 1 );
+} /* end search_history() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: free_search                                   */
+/*      Return type:   void                                          */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          waits for the indexing thread and frees the index.       */
+/*                                                                   */
+/*********************************************************************/
+void free_search( void )
+{
+    free( draft );
+    draft = NULL;
+
+    if( !builder.started )
+        return;
+
+    pthread_join( builder.thread, NULL );
+    free( builder.index.starts );
+    free( builder.index.entries );
+
+    memset( &builder.index, 0, sizeof(builder.index) );
+    atomic_store( &builder.ready, F );
+    builder.started = F;
+} /* end free_search() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: start_line                                    */
+/*      Return type:   int - 0, as readline expects                  */
+/*      Parameter(s):  none                                          */
+/*      Description:                                                 */
+/*          runs as readline starts a line, which starts at the      */
+/*          newest command again.                                    */
+/*                                                                   */
+/*********************************************************************/
+static int start_line( void )
+{
+    browsing = 0;
+    free( draft );
+    draft = NULL;
+
+    return 0;
+} /* end start_line() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: previous_key                                  */
+/*      Return type:   int - 0, as readline expects                  */
+/*      Parameter(s):                                                */
+/*          int count: unused                                        */
+/*          int key: unused                                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          puts the command before the one on the line on it, the   */
+/*          line being typed is kept for next_key(). Goes back past  */
+/*          histsize into the file.                                  */
+/*                                                                   */
+/*********************************************************************/
+static int previous_key( int count, int key )
+{
+    long n = ( browsing == 0 ? history_count() : browsing - 1 );
+
+    if( n < 1 )
+    {
+        rl_ding();
+        return 0;
+    }
+
+    if( browsing == 0 )
+    {
+        free( draft );
+        draft = strdup( rl_line_buffer );
+    }
+
+    if( show_entry( n, "", 0 ) == SUCCESS )
+        browsing = n;
+
+    return 0;
+} /* end previous_key() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: next_key                                      */
+/*      Return type:   int - 0, as readline expects                  */
+/*      Parameter(s):                                                */
+/*          int count: unused                                        */
+/*          int key: unused                                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          puts the command after the one on the line on it, past   */
+/*          the newest the line that was being typed.                */
+/*                                                                   */
+/*********************************************************************/
+static int next_key( int count, int key )
+{
+    if( browsing == 0 )
+    {
+        rl_ding();
+        return 0;
+    }
+
+    if( browsing < history_count() )
+    {
+        if( show_entry( browsing + 1, "", 0 ) == SUCCESS )
+            browsing++;
+        return 0;
+    }
+
+    rl_replace_line( ( draft == NULL ? "" : draft ), 0 );
+    rl_point = rl_end;
+    browsing = 0;
+
+    return 0;
+} /* end next_key() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: search_key                                    */
+/*      Return type:   int - 0, as readline expects                  */
+/*      Parameter(s):                                                */
+/*          int count: unused                                        */
+/*          int key: unused                                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          runs when Ctrl-R is pressed. Every key typed narrows the */
+/*          search and puts the newest command that matches on the   */
+/*          line, Ctrl-R again goes to an older one and Ctrl-G puts  */
+/*          the line back as it was. Any other key ends the search   */
+/*          with the command on the line and is then handled as      */
+/*          usual, so Enter runs it.                                 */
+/*                                                                   */
+/*********************************************************************/
+static int search_key( int count, int key )
+{
+    char text[SEARCH_QUERY_SIZE];
+    char* saved;
+    size_t length = 0;
+    long match = 0, found;
+    int c, point = rl_point, failed = F;
+
+    if( ( saved = strdup( rl_line_buffer ) ) == NULL )
+        return 0;
+
+    text[0] = '\0';
+    rl_save_prompt();
+
+    while( 1 )
+    {
+        rl_message( ( failed ? SEARCH_FAILED_PROMPT : SEARCH_PROMPT ), text );
+        c = rl_read_key();
+
+        if( c == CTRL( 'r' ) )
+            found = search_history( text, length, ( match == 0 ? history_count() + 1 : match ) );
+        else if( c == RUBOUT || c == CTRL( 'h' ) )
+        {
+            // start again from the newest with one key less
+            if( length > 0 )
+                text[--length] = '\0';
+            found = search_history( text, length, history_count() + 1 );
+        }
+        else if( c == CTRL( 'g' ) )
+        {
+            rl_replace_line( saved, 0 );
+            rl_point = point;
+            break;
+        }
+        else if( ( isprint( c ) || c >= 0x80 ) && length < SEARCH_QUERY_SIZE - 1 )
+        {
+            // the command on the line may still match
+            text[length++] = (char)c;
+            text[length] = '\0';
+            found = search_history( text, length, ( match == 0 ? history_count() + 1 : match + 1 ) );
+        }
+        else
+        {
+            rl_execute_next( c );
+            break;
+        }
+
+        failed = ( found == 0 && length > 0 );
+        if( found != 0 && show_entry( found, text, length ) == SUCCESS )
+            match = found;
+        else if( length > 0 )
+            rl_ding();
+    }
+
+    rl_restore_prompt();
+    rl_clear_message();
+
+    // the arrows go on from the command found
+    if( match != 0 && c != CTRL( 'g' ) )
+    {
+        if( browsing == 0 )
+        {
+            free( draft );
+            draft = saved;
+            saved = NULL;
+        }
+        browsing = match;
+    }
+    free( saved );
+
+    return 0;
+} /* end search_key() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: show_entry                                    */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          long n: number of the command found                      */
+/*          const char* text: what was searched for                  */
+/*          size_t length: length of text                            */
+/*                                                                   */
+/*      Description:                                                 */
+/*          puts command n on the line, the cursor on what matched   */
+/*          or at the end when nothing was searched for.             */
+/*                                                                   */
+/*********************************************************************/
+static int show_entry( long n, const char* text, size_t length )
+{
+    const char* entry;
+    char* line;
+    size_t entry_length;
+
+    if( ( entry = find_history_entry( n, &entry_length ) ) == NULL ||
+        ( line = (char*)malloc( entry_length + 1 ) ) == NULL )
+        return FAILURE;
+
+    // commands read from the file are not terminated
+    memcpy( line, entry, entry_length );
+    line[entry_length] = '\0';
+
+    rl_replace_line( line, 0 );
+    rl_point = ( length == 0 ? rl_end : (int)( find_text( entry, entry_length, text, length ) - entry ) );
+    free( line );
+
+    return SUCCESS;
+} /* end show_entry() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: build_index                                   */
+/*      Return type:   void* - always NULL                           */
+/*      Parameter(s):                                                */
+/*          void* arg: unused                                        */
+/*                                                                   */
+/*      Description:                                                 */
+/*          body of the indexing thread. Maps the history file on    */
+/*          its own, so it shares nothing with the shell, counts the */
+/*          commands of every trigram bucket, then fills the lists   */
+/*          in a second pass, and sets ready once they can be used.  */
+/*                                                                   */
+/*********************************************************************/
+static void* build_index( void* arg )
+{
+    search_index index = { NULL, NULL, 0, 0 };
+    struct stat info;
+    uint32_t* last = NULL, * cursor = NULL;
+    char* map = NULL;
+    int fd, b;
+
+    if( ( fd = open_for_shell( builder.path, O_RDONLY, 0 ) ) == -1 )
+        return NULL;
+
+    if( fstat( fd, &info ) == -1 || info.st_size == 0 ||
+        ( map = (char*)mmap( NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 ) ) == MAP_FAILED )
+    {
+        close( fd );
+        return NULL;
+    }
+    close( fd );
+    index.inode = (uint64_t)info.st_ino;
+
+    index.starts = (uint32_t*)calloc( SEARCH_BUCKETS + 1, sizeof(uint32_t) );
+    last = (uint32_t*)calloc( SEARCH_BUCKETS, sizeof(uint32_t) );
+    cursor = (uint32_t*)malloc( SEARCH_BUCKETS * sizeof(uint32_t) );
+
+    if( index.starts != NULL && last != NULL && cursor != NULL )
+    {
+        // starts[b + 1] counts the commands in bucket b, then
+        // adding them up gives where each bucket starts
+        index_commands( map, (size_t)info.st_size, last, index.starts, NULL );
+        for( b = 0; b < SEARCH_BUCKETS; b++ )
+            index.starts[b + 1] += index.starts[b];
+
+        if( ( index.entries = (uint32_t*)malloc( ( index.starts[SEARCH_BUCKETS] + 1 ) * sizeof(uint32_t) ) ) != NULL )
+        {
+            memcpy( cursor, index.starts, SEARCH_BUCKETS * sizeof(uint32_t) );
+            memset( last, 0, SEARCH_BUCKETS * sizeof(uint32_t) );
+            index.count = (size_t)index_commands( map, (size_t)info.st_size, last, cursor, index.entries );
+        }
+    }
+
+    munmap( map, (size_t)info.st_size );
+    free( last );
+    free( cursor );
+
+    if( index.entries == NULL )
+    {
+        fprintf( stderr, "Error allocating memory for the history search.\n" );
+        free( index.starts );
+        return NULL;
+    }
+
+    builder.index = index;
+    atomic_store( &builder.ready, T );
+
+    return NULL;
+} /* end build_index() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: index_commands                                */
+/*      Return type:   long - number of commands                     */
+/*      Parameter(s):                                                */
+/*          const char* map: the history file                        */
+/*          size_t size: size of the file                            */
+/*          uint32_t* last: last command seen in each bucket, so a   */
+/*                          command is only listed once in each      */
+/*          uint32_t* slots: bucket counts, or where the next        */
+/*                           command of each bucket goes             */
+/*          uint32_t* entries: the lists, NULL to only count         */
+/*                                                                   */
+/*      Description:                                                 */
+/*          goes over every trigram of every complete command in the */
+/*          file, counting it in slots[bucket + 1] or adding the     */
+/*          command to entries[slots[bucket]]. A command is numbered */
+/*          by its line, as find_history_entry() numbers it.         */
+/*                                                                   */
+/*********************************************************************/
+static long index_commands( const char* map, size_t size, uint32_t* last,
+                            uint32_t* slots, uint32_t* entries )
+{
+    const char* line = map, * end = map + size, * newline, * command;
+    uint32_t n = 0, bucket;
+
+    while( line < end && ( newline = (const char*)memchr( line, '\n', (size_t)( end - line ) ) ) != NULL )
+    {
+        n++;
+        for( command = skip_history_fields( line, newline ); command + 3 <= newline; command++ )
+        {
+            bucket = trigram_bucket( command );
+            if( last[bucket] == n )
+                continue;
+            last[bucket] = n;
+
+            if( entries == NULL )
+                slots[bucket + 1]++;
+            else
+                entries[slots[bucket]++] = n;
+        }
+        line = newline + 1;
+    }
+
+    return (long)n;
+} /* end index_commands() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: search_index_for                              */
+/*      Return type:   long - number of the command, 0 if none       */
+/*      Parameter(s):                                                */
+/*          const char* text: what to look for, 3 bytes or more      */
+/*          size_t length: length of text                            */
+/*          long before: only commands older than this one, at most  */
+/*                       one past the last command indexed           */
+/*                                                                   */
+/*      Description:                                                 */
+/*          walks back through the shortest list of the trigrams of  */
+/*          text. A command in every other list may contain text,    */
+/*          and is looked at to make sure.                           */
+/*                                                                   */
+/*********************************************************************/
+static long search_index_for( const char* text, size_t length, long before )
+{
+    uint32_t buckets[SEARCH_QUERY_SIZE];
+    uint32_t* list;
+    const char* entry;
+    size_t n_buckets = 0, i, j, smallest = 0, low, high, middle, entry_length;
+
+    for( i = 0; i + 3 <= length; i++ )
+    {
+        buckets[n_buckets] = trigram_bucket( text + i );
+        for( j = 0; buckets[j] != buckets[n_buckets]; j++ )
+            continue;
+        if( j < n_buckets )
+            continue;
+
+        if( builder.index.starts[buckets[n_buckets] + 1] - builder.index.starts[buckets[n_buckets]] <
+            builder.index.starts[buckets[smallest] + 1] - builder.index.starts[buckets[smallest]] )
+            smallest = n_buckets;
+        n_buckets++;
+    }
+
+    list = builder.index.entries + builder.index.starts[buckets[smallest]];
+    high = builder.index.starts[buckets[smallest] + 1] - builder.index.starts[buckets[smallest]];
+
+    // the commands of the list older than before
+    for( low = 0; low < high; )
+    {
+        middle = low + ( high - low ) / 2;
+        if( (long)list[middle] < before )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    while( low-- > 0 )
+    {
+        for( j = 0; j < n_buckets; j++ )
+        {
+            if( j != smallest && !has_entry( buckets[j], list[low] ) )
+                break;
+        }
+
+        if( j == n_buckets && ( entry = find_history_entry( list[low], &entry_length ) ) != NULL &&
+            find_text( entry, entry_length, text, length ) != NULL )
+            return (long)list[low];
+    }
+
+    return 0;
+} /* end search_index_for() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: has_entry                                     */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          uint32_t bucket: trigram bucket                          */
+/*          uint32_t n: number of a command                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          looks for command n in the sorted list of bucket.        */
+/*                                                                   */
+/*********************************************************************/
+static int has_entry( uint32_t bucket, uint32_t n )
+{
+    uint32_t low = builder.index.starts[bucket], high = builder.index.starts[bucket + 1], middle;
+
+    while( low < high )
+    {
+        middle = low + ( high - low ) / 2;
+        if( builder.index.entries[middle] == n )
+            return T;
+        if( builder.index.entries[middle] < n )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return F;
+} /* end has_entry() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_text                                     */
+/*      Return type:   const char* - where text is, NULL if nowhere  */
+/*      Parameter(s):                                                */
+/*          const char* entry: command, not terminated               */
+/*          size_t entry_length: length of entry                     */
+/*          const char* text: what to look for                       */
+/*          size_t length: length of text                            */
+/*                                                                   */
+/*********************************************************************/
+static const char* find_text( const char* entry, size_t entry_length,
+                              const char* text, size_t length )
+{
+    const char* end = entry + entry_length;
+
+    while( (size_t)( end - entry ) >= length &&
+           ( entry = (const char*)memchr( entry, text[0], (size_t)( end - entry ) - length + 1 ) ) != NULL )
+    {
+        if( memcmp( entry, text, length ) == 0 )
+            return entry;
+        entry++;
+    }
+
+    return NULL;
+} /* end find_text() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: trigram_bucket                                */
+/*      Return type:   uint32_t                                      */
+/*      Parameter(s):                                                */
+/*          const char* p: the 3 bytes                               */
+/*                                                                   */
+/*      Description:                                                 */
+/*          hashes a trigram into one of SEARCH_BUCKETS lists.       */
+/*          Trigrams sharing a list only cost a look at a command    */
+/*          that does not match.                                     */
+/*                                                                   */
+/*********************************************************************/
+static uint32_t trigram_bucket( const char* p )
+{
+    uint32_t trigram = (uint32_t)(unsigned char)p[0] << 16 | (uint32_t)(unsigned char)p[1] << 8 |
+                       (uint32_t)(unsigned char)p[2];
+
+    // Fibonacci hashing, the top bits are the best mixed
+    return ( trigram * 2654435761u ) >> 16 & ( SEARCH_BUCKETS - 1 );
+} /* end trigram_bucket() */
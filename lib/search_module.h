@@ -0,0 +1,78 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: search_module.h                             */
+/*          Description:                                             */
+/*              This module connects readline to the shell's         */
+/*              history. The arrow keys step through every command,  */
+/*              back into the history file, and Ctrl-R is the        */
+/*              reverse incremental search over the whole file.      */
+/*              Every 3 bytes in a command (a trigram) lead to a     */
+/*              list of the commands they appear in, so a search     */
+/*              only looks at commands that have every trigram of    */
+/*              what was typed. The index is built by a thread the   */
+/*              first time Ctrl-R is pressed, until then the         */
+/*              commands are scanned.                                */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef SEARCH_MODULE_H
+#define SEARCH_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <readline/readline.h>
+#include "string_module.h"
+#include "variable_module.h"
+#include "history_module.h"
+#include "history_file_module.h"
+
+/* macros */
+#define SEARCH_BUCKETS 65536        /* trigrams are hashed into this    */
+                                    /* many lists, a power of 2         */
+#define SEARCH_QUERY_SIZE 256       /* longest text searched for        */
+#define SEARCH_PROMPT "(reverse-i-search)`%s': "
+#define SEARCH_FAILED_PROMPT "(failed reverse-i-search)`%s': "
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* for each trigram bucket, the commands it appears in, oldest */
+/* first: those of bucket b are entries[starts[b]] up to       */
+/* entries[starts[b + 1]]                                      */
+typedef struct search_index_t
+{
+    uint32_t*   starts;         /* SEARCH_BUCKETS + 1 of them          */
+    uint32_t*   entries;        /* command numbers                     */
+    size_t      count;          /* commands indexed, 1 to count        */
+    uint64_t    inode;          /* of the history file indexed         */
+} search_index;
+
+/* the thread building the index */
+typedef struct search_builder_t
+{
+    char            path[PATH_MAX];     /* history file                   */
+    int             started;            /* T once the thread was started  */
+    atomic_int      ready;              /* T once index can be used       */
+    pthread_t       thread;
+    search_index    index;
+} search_builder;
+
+/* function prototypes */
+void    init_search( void );
+long    search_history( const char* text, size_t length, long before );
+void    free_search( void );
+
+#endif
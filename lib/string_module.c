@@ -1,8 +1,94 @@
 #include "string_module.h"
 
+/* character classes seen by the lexer */
+enum char_class
+{
+    CC_WORD, CC_DIGIT, CC_SPACE, CC_SQUOTE, CC_DQUOTE, CC_BACKSLASH, CC_DOLLAR,
+    CC_BACKTICK, CC_PIPE, CC_AMP, CC_SEMI, CC_LESS, CC_GREAT, CC_END, N_CLASSES
+};
+
+/* lexer states, S_PIPE and later are inside an operator */
+enum lex_state
+{
+    S_BLANK, S_WORD, S_NUMBER, S_SQUOTE, S_DQUOTE, S_ESCAPE, S_DQ_ESCAPE,
+    S_PIPE, S_OR, S_AMP, S_AND, S_SEMI, S_LESS, S_GREAT, S_APPEND,
+    S_DUP_IN, S_DUP_OUT, N_STATES
+};
+
+/* what to do with the current character */
+enum lex_action
+{
+    ACT_SKIP,           /* ignore it                                  */
+    ACT_BEGIN,          /* start a token with it                      */
+    ACT_ADD,            /* add it to the token                        */
+    ACT_END,            /* end the token, then look at it again       */
+    ACT_SUBST,          /* start or add to a token, skipping a whole  */
+                        /* $(...), ${...} or `...` if one starts here */
+    ACT_STOP            /* end of line                                */
+};
+
+/* one entry of the transition table */
+typedef struct lex_step_t
+{
+    unsigned char   next;
+    unsigned char   action;
+} lex_step;
+
 /* static function prototypes */
-static int     is_special_char( const char c );
-static void    save_word( char* cmd, char* cmds[], int* pos, int* cmd_len );
+static int     save_token( token_vector* tokens, int offset, int length, token_kind kind );
+
+/* token views of the line being parsed, kept between lines */
+static token_vector    scratch_tokens = { NULL, 0, 0 };
+
+/* class of every byte, anything not listed is part of a word */
+static const unsigned char char_class[256] =
+{
+    ['\0'] = CC_END,
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE,
+    ['\v'] = CC_SPACE, ['\f'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['0'] = CC_DIGIT, ['1'] = CC_DIGIT, ['2'] = CC_DIGIT, ['3'] = CC_DIGIT, ['4'] = CC_DIGIT,
+    ['5'] = CC_DIGIT, ['6'] = CC_DIGIT, ['7'] = CC_DIGIT, ['8'] = CC_DIGIT, ['9'] = CC_DIGIT,
+    ['\''] = CC_SQUOTE, ['\"'] = CC_DQUOTE, ['\\'] = CC_BACKSLASH,
+    ['$'] = CC_DOLLAR, ['`'] = CC_BACKTICK,
+    ['|'] = CC_PIPE, ['&'] = CC_AMP, [';'] = CC_SEMI, ['<'] = CC_LESS, ['>'] = CC_GREAT
+};
+
+/* shorthand for the transition table */
+#define GO( state, action ) { state, action }
+#define END_TOKEN GO( S_BLANK, ACT_END )
+#define END_ROW { END_TOKEN, END_TOKEN, END_TOKEN, END_TOKEN, END_TOKEN, END_TOKEN, END_TOKEN, \
+                  END_TOKEN, END_TOKEN, END_TOKEN, END_TOKEN, END_TOKEN, END_TOKEN, END_TOKEN }
+
+/* next state and action for each state and character class */
+static const lex_step transitions[N_STATES][N_CLASSES] =
+{
+    /*                CC_WORD                  CC_DIGIT                   CC_SPACE                 CC_SQUOTE                  CC_DQUOTE                  CC_BACKSLASH                CC_DOLLAR                  CC_BACKTICK                CC_PIPE                  CC_AMP                    CC_SEMI                  CC_LESS                  CC_GREAT                  CC_END */
+    [S_BLANK]     = { GO( S_WORD, ACT_BEGIN ), GO( S_NUMBER, ACT_BEGIN ), GO( S_BLANK, ACT_SKIP ), GO( S_SQUOTE, ACT_BEGIN ), GO( S_DQUOTE, ACT_BEGIN ), GO( S_ESCAPE, ACT_BEGIN ),  GO( S_WORD, ACT_SUBST ),   GO( S_WORD, ACT_SUBST ),   GO( S_PIPE, ACT_BEGIN ), GO( S_AMP, ACT_BEGIN ),   GO( S_SEMI, ACT_BEGIN ), GO( S_LESS, ACT_BEGIN ), GO( S_GREAT, ACT_BEGIN ), GO( S_BLANK, ACT_STOP ) },
+    [S_WORD]      = { GO( S_WORD, ACT_ADD ),   GO( S_WORD, ACT_ADD ),     END_TOKEN,               GO( S_SQUOTE, ACT_ADD ),   GO( S_DQUOTE, ACT_ADD ),   GO( S_ESCAPE, ACT_ADD ),    GO( S_WORD, ACT_SUBST ),   GO( S_WORD, ACT_SUBST ),   END_TOKEN,               END_TOKEN,                END_TOKEN,               END_TOKEN,               END_TOKEN,                END_TOKEN },
+    [S_NUMBER]    = { GO( S_WORD, ACT_ADD ),   GO( S_NUMBER, ACT_ADD ),   END_TOKEN,               GO( S_SQUOTE, ACT_ADD ),   GO( S_DQUOTE, ACT_ADD ),   GO( S_ESCAPE, ACT_ADD ),    GO( S_WORD, ACT_SUBST ),   GO( S_WORD, ACT_SUBST ),   END_TOKEN,               END_TOKEN,                END_TOKEN,               GO( S_LESS, ACT_ADD ),   GO( S_GREAT, ACT_ADD ),   END_TOKEN },
+    [S_SQUOTE]    = { GO( S_SQUOTE, ACT_ADD ), GO( S_SQUOTE, ACT_ADD ),   GO( S_SQUOTE, ACT_ADD ), GO( S_WORD, ACT_ADD ),     GO( S_SQUOTE, ACT_ADD ),   GO( S_SQUOTE, ACT_ADD ),    GO( S_SQUOTE, ACT_ADD ),   GO( S_SQUOTE, ACT_ADD ),   GO( S_SQUOTE, ACT_ADD ), GO( S_SQUOTE, ACT_ADD ),  GO( S_SQUOTE, ACT_ADD ), GO( S_SQUOTE, ACT_ADD ), GO( S_SQUOTE, ACT_ADD ),  END_TOKEN },
+    [S_DQUOTE]    = { GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ),   GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ),   GO( S_WORD, ACT_ADD ),     GO( S_DQ_ESCAPE, ACT_ADD ), GO( S_DQUOTE, ACT_SUBST ), GO( S_DQUOTE, ACT_SUBST ), GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ),  GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ),  END_TOKEN },
+    [S_ESCAPE]    = { GO( S_WORD, ACT_ADD ),   GO( S_WORD, ACT_ADD ),     GO( S_WORD, ACT_ADD ),   GO( S_WORD, ACT_ADD ),     GO( S_WORD, ACT_ADD ),     GO( S_WORD, ACT_ADD ),      GO( S_WORD, ACT_ADD ),     GO( S_WORD, ACT_ADD ),     GO( S_WORD, ACT_ADD ),   GO( S_WORD, ACT_ADD ),    GO( S_WORD, ACT_ADD ),   GO( S_WORD, ACT_ADD ),   GO( S_WORD, ACT_ADD ),    END_TOKEN },
+    [S_DQ_ESCAPE] = { GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ),   GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ),   GO( S_DQUOTE, ACT_ADD ),   GO( S_DQUOTE, ACT_ADD ),    GO( S_DQUOTE, ACT_ADD ),   GO( S_DQUOTE, ACT_ADD ),   GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ),  GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ), GO( S_DQUOTE, ACT_ADD ),  END_TOKEN },
+    [S_PIPE]      = { END_TOKEN,               END_TOKEN,                 END_TOKEN,               END_TOKEN,                 END_TOKEN,                 END_TOKEN,                  END_TOKEN,                 END_TOKEN,                 GO( S_OR, ACT_ADD ),     END_TOKEN,                END_TOKEN,               END_TOKEN,               END_TOKEN,                END_TOKEN },
+    [S_OR]        = END_ROW,
+    [S_AMP]       = { END_TOKEN,               END_TOKEN,                 END_TOKEN,               END_TOKEN,                 END_TOKEN,                 END_TOKEN,                  END_TOKEN,                 END_TOKEN,                 END_TOKEN,               GO( S_AND, ACT_ADD ),     END_TOKEN,               END_TOKEN,               END_TOKEN,                END_TOKEN },
+    [S_AND]       = END_ROW,
+    [S_SEMI]      = END_ROW,
+    [S_LESS]      = { END_TOKEN,               END_TOKEN,                 END_TOKEN,               END_TOKEN,                 END_TOKEN,                 END_TOKEN,                  END_TOKEN,                 END_TOKEN,                 END_TOKEN,               GO( S_DUP_IN, ACT_ADD ),  END_TOKEN,               END_TOKEN,               END_TOKEN,                END_TOKEN },
+    [S_GREAT]     = { END_TOKEN,               END_TOKEN,                 END_TOKEN,               END_TOKEN,                 END_TOKEN,                 END_TOKEN,                  END_TOKEN,                 END_TOKEN,                 END_TOKEN,               GO( S_DUP_OUT, ACT_ADD ), END_TOKEN,               END_TOKEN,               GO( S_APPEND, ACT_ADD ),  END_TOKEN },
+    [S_APPEND]    = END_ROW,
+    [S_DUP_IN]    = { END_TOKEN,               GO( S_DUP_IN, ACT_ADD ),   END_TOKEN,               END_TOKEN,                 END_TOKEN,                 END_TOKEN,                  END_TOKEN,                 END_TOKEN,                 END_TOKEN,               END_TOKEN,                END_TOKEN,               END_TOKEN,               END_TOKEN,                END_TOKEN },
+    [S_DUP_OUT]   = { END_TOKEN,               GO( S_DUP_OUT, ACT_ADD ),  END_TOKEN,               END_TOKEN,                 END_TOKEN,                 END_TOKEN,                  END_TOKEN,                 END_TOKEN,                 END_TOKEN,               END_TOKEN,                END_TOKEN,               END_TOKEN,               END_TOKEN,                END_TOKEN }
+};
+
+/* kind of token we have when a state ends it */
+static const unsigned char state_kind[N_STATES] =
+{
+    [S_PIPE] = TOKEN_PIPE, [S_OR] = TOKEN_OR, [S_AMP] = TOKEN_BACKGROUND, [S_AND] = TOKEN_AND,
+    [S_SEMI] = TOKEN_SEMICOLON, [S_LESS] = TOKEN_REDIRECT_IN, [S_GREAT] = TOKEN_REDIRECT_OUT,
+    [S_APPEND] = TOKEN_APPEND, [S_DUP_IN] = TOKEN_DUP_IN, [S_DUP_OUT] = TOKEN_DUP_OUT
+};
 
 /*********************************************************************/
 /*                                                                   */
@@ -10,93 +96,183 @@ static void    save_word( char* cmd, char* cmds[], int* pos, int* cmd_len );
 /*      Return type:   int                                           */
 /*      Parameter(s):                                                */
 /*          char* line: line of commands user types into shell       */
-/*          char* cmds[]: array of strings to place each command in  */
-/*          int* count: pointer to var holding the count in cmds[]   */
+/*          word_vector* cmds: vector to append each command to      */
 /*                                                                   */
 /*      Description:                                                 */
 /*          This function splits a string into an array              */
 /*          of strings, each string in the array representing        */
 /*          one of the words in the command line                     */
-/*          A pointer to the int representing the count of commands  */
-/*          in the array of strings is passed so we can update how   */
-/*          many commands are stored in the array                    */
+/*          Every word is copied into line_arena, so line is left    */
+/*          untouched. Use parse_line_in_place() when line may be    */
+/*          modified.                                                */
 /*                                                                   */
 /*********************************************************************/
-int parse_string( char* line, char* cmds[], int* count )
+int parse_string( char* line, word_vector* cmds )
 {
-    // cmd stores each individual word within the string "line"
-    char cmd[WORD_LIMIT] = "";
-    int i, idx = 0, end_of_line = strlen( line ) - 1;
+    char* copy;
 
-    // go through entire line
-    for( i = 0; i <= end_of_line; i++ )
-    {
-        // bounds checking
-        if( idx == WORD_LIMIT - 1 )
-        {
-            fprintf( stderr, "Error: parser detected word larger than %d characters\n", WORD_LIMIT );
-            fprintf( stderr, "       first %d characters of word in question: %s\n", WORD_LIMIT, cmd );
-            return FAILURE;
-        }
+    // the tokenizer may shift characters around, so work on a copy
+    if( ( copy = arena_strdup( &line_arena, line ) ) == NULL )
+        return FAILURE;
 
-        // special character check
-        if ( is_special_char( line[i] ) )
-        {
-            // save word
-            save_word( cmd, cmds, count, &idx );
+    return parse_line_in_place( copy, cmds );
+} /* end parse_string() */
 
-            // add the special char as a word to the arr
-            cmd[idx++] = line[i];
-        
-            save_word( cmd, cmds, count, &idx );
-        }
-        else if ( i == end_of_line ) // end of line
-        {
-            // if its not a space, append char to cmd
-            if( !isspace( line[i] ) )
-                cmd[idx++] = line[i];
 
-            // add final word to cmds[]
-            save_word( cmd, cmds, count, &idx );
-        }
-        else if ( line[i] == '\"' || line[i] == '\'' ) // string in quotes
-        {
-            char end_quote = line[i++];
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: parse_line_in_place                           */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          char* line: line of commands user types into shell       */
+/*          word_vector* cmds: vector to append each command to      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          Same as parse_string(), but the words in cmds point      */
+/*          straight into line, which gets NUL terminators written   */
+/*          into it. Nothing is copied except words glued to an      */
+/*          operator (e.g. "ls>out").                                */
+/*          line must outlive cmds.                                  */
+/*                                                                   */
+/*********************************************************************/
+int parse_line_in_place( char* line, word_vector* cmds )
+{
+    if( tokenize_line( line, &scratch_tokens ) == FAILURE )
+        return FAILURE;
+
+    return terminate_tokens( line, &scratch_tokens, cmds );
+} /* end parse_line_in_place() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: tokenize_line                                 */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          char* line: line of commands user types into shell       */
+/*          token_vector* tokens: where each word's view is stored   */
+/*                                                                   */
+/*      Description:                                                 */
+/*          Finds the words and operators in line without copying    */
+/*          them. Each token records the offset, length and kind of  */
+/*          a word. Every character is looked up in char_class[],    */
+/*          and the state and class pick the next state and action   */
+/*          from transitions[].                                      */
+/*          Quotes and backslashes stay in the token, the states     */
+/*          only track them so an operator or space inside quotes    */
+/*          does not end the word. They are removed when the word    */
+/*          is expanded. A command substitution is kept whole in     */
+/*          the word it is part of. A quote still open at the end of */
+/*          the line is a syntax error.                              */
+/*                                                                   */
+/*********************************************************************/
+int tokenize_line( char* line, token_vector* tokens )
+{
+    int r = 0, start = -1, len = strlen( line );
+    int state = S_BLANK;
+    lex_step step;
+
+    tokens->count = 0;
 
-            // build command with everything inside quotes
-            do
-            {
-                // bounds checking
-                if( idx == WORD_LIMIT - 1 )
+    // go through entire line, including the NUL
+    for( ;; )
+    {
+        step = transitions[state][char_class[(unsigned char)line[r]]];
+
+        switch( step.action )
+        {
+            case ACT_SKIP:
+            case ACT_ADD:
+                r++;
+                break;
+            case ACT_BEGIN:
+                start = r++;
+                break;
+            case ACT_END:
+                // the line ended inside quotes
+                if( line[r] == '\0' && ( state == S_SQUOTE || state == S_DQUOTE || state == S_DQ_ESCAPE ) )
                 {
-                    fprintf( stderr, "Error: parser detected word larger than %d characters\n", WORD_LIMIT );
-                    fprintf( stderr, "       first %d characters of word in question: %s\n", WORD_LIMIT, cmd );
+                    fprintf( stderr, "Error: syntax error, %s quote is not closed\n", ( state == S_SQUOTE ? "single" : "double" ) );
                     return FAILURE;
                 }
 
-                // check if user forgot end quote
-                if( i == end_of_line )
+                // character is looked at again in S_BLANK
+                if( save_token( tokens, start, r - start, state_kind[state] ) == FAILURE )
+                    return FAILURE;
+                break;
+            case ACT_SUBST:
+                // spaces and operators inside $(...), ${...} or `...`
+                // belong to the word, a lone '$' is just added
+                if( state == S_BLANK )
+                    start = r;
+                if( ( r = find_substitution_end( line, r ) ) == -1 )
                 {
-                    cmd[idx++] = line[i]; 
-                    break;
+                    fprintf( stderr, "Error: substitution is not closed\n" );
+                    return FAILURE;
                 }
+                break;
+            case ACT_STOP:
+                return SUCCESS;
+        }
+
+        // inside a plain word, jump straight to the end of it
+        if( step.next == S_WORD )
+            r = scan_to_boundary( line, r, len );
+
+        state = step.next;
+    }
+} /* end tokenize_line() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: terminate_tokens                              */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          char* line: line the tokens were taken from              */
+/*          token_vector* tokens: views from tokenize_line()         */
+/*          word_vector* cmds: vector to append each word to         */
+/*                                                                   */
+/*      Description:                                                 */
+/*          Writes a NUL after every word in line so cmds can be     */
+/*          handed to execvp() as is. A word directly followed by    */
+/*          another word has no room for its NUL, so that word is    */
+/*          copied instead.                                          */
+/*                                                                   */
+/*********************************************************************/
+int terminate_tokens( char* line, token_vector* tokens, word_vector* cmds )
+{
+    token* t = tokens->tokens;
+    char* word;
+    int i, end;
 
-                cmd[idx++] = line[i];
-            }
-            while( line[++i] != end_quote );
+    // make room for every word up front
+    if( reserve_strings( cmds, cmds->count + tokens->count ) == FAILURE )
+        return FAILURE;
 
-            // add entire quoted string as one command
-            save_word( cmd, cmds, count, &idx );
+    for( i = 0; i < tokens->count; i++ )
+    {
+        end = t[i].offset + t[i].length;
+
+        // next word starts right where this one ends, copy it
+        if( i + 1 < tokens->count && t[i + 1].offset == end )
+        {
+            if( ( word = arena_strndup( &line_arena, &line[t[i].offset], t[i].length ) ) == NULL )
+                return FAILURE;
         }
-        else if ( isspace( line[i] ) ) // if space, save word
-            save_word( cmd, cmds, count, &idx );
-        else // everything else, build the word 
-            cmd[idx++] = line[i];
+        else
+        {
+            line[end] = '\0';
+            word = &line[t[i].offset];
+        }
+
+        cmds->kinds[cmds->count] = t[i].kind;
+        cmds->words[cmds->count++] = word;
     }
-    cmds[*count] = NULL;
+    cmds->words[cmds->count] = NULL;
 
     return SUCCESS;
-} /* end split_input() */
+} /* end terminate_tokens() */
 
 
 /*********************************************************************/
@@ -107,10 +283,11 @@ int parse_string( char* line, char* cmds[], int* count )
 /*          char* str: pointer to string we are adding               */
 /*          char* arr[]: pointer(address) of the array of strings    */
 /*                       we are adding str to                        */
-/*          int* count: pointer to the count of commands in arr[]    */
+/*          int index: location in arr[] to place the copy           */
 /*                                                                   */
 /*      Description:                                                 */
-/*          adds a string to an array of pointers to char.           */
+/*          adds a copy of a string to an array of pointers to char. */
+/*          The copy lives in line_arena until it is reset.          */
 /*                                                                   */
 /*********************************************************************/
 int add_string( char* str, char* arr[], int index )
@@ -122,195 +299,323 @@ int add_string( char* str, char* arr[], int index )
         return SUCCESS;
     }
 
-    // do bounds checking
-    if( index >= MAX_CMDS )
+    // copy the string to the array
+    if ( ( arr[index] = arena_strdup( &line_arena, str ) ) == NULL )
     {
-        // exit gracefully
-        fprintf( stderr, "Error: command too large. Commands should be %d words or less\n", MAX_CMDS );
+        fprintf( stderr, "Error: could not allocate memory for word in arr[] - %s\n", str );
         return FAILURE;
     }
 
-    // allocate memory for str in the array
-    if ( ( arr[index] = (char*)malloc( ( strlen(str) + 1 ) * sizeof(char) ) ) == NULL )
-    {
-        fprintf( stderr, "Error: could not allocate memory for word in arr[] - %s\n", str );
+    return SUCCESS;
+}/* end add_string() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: push_string                                   */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          char* str: string to append (not copied)                 */
+/*          word_vector* vec: vector we are appending to             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          appends the word str to the end of vec, growing it if    */
+/*          needed.                                                  */
+/*                                                                   */
+/*********************************************************************/
+int push_string( char* str, word_vector* vec )
+{
+    if( reserve_strings( vec, vec->count + 1 ) == FAILURE )
         return FAILURE;
-    }
 
-    // copy the string to the array
-    strcpy( arr[index], str );
+    vec->kinds[vec->count] = TOKEN_WORD;
+    vec->words[vec->count++] = str;
+    vec->words[vec->count] = NULL;
 
     return SUCCESS;
-}/* end add_string() */
+} /* end push_string() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: merge_string_arrays                           */
+/*      Function name: reserve_strings                               */
 /*      Return type:   int                                           */
 /*      Parameter(s):                                                */
-/*          char* dest[]: array of strings we are adding src[] to    */
-/*          int* dest_cnt: count of strings in dest[]                */
-/*          char* src[]: array of strings we are merging into dest[] */
-/*          int src_cnt: count of strings in src[]                   */
-/*          int index: location in dest that we want to add src to   */
+/*          word_vector* vec: vector to grow                         */
+/*          int capacity: number of words vec must be able to hold   */
 /*                                                                   */
 /*      Description:                                                 */
-/*          merges one array into the other, user should perform     */
-/*          adequate bounds checking prior to calling this.          */
+/*          makes room for capacity words plus the NULL terminator.  */
+/*          The vector doubles in size so appends are amortized      */
+/*          O(1), and it never shrinks so it is reused line to line. */
 /*                                                                   */
 /*********************************************************************/
-int merge_string_arrays( char* dest[], int dest_cnt, char* src[], int src_cnt, int index )
+int reserve_strings( word_vector* vec, int capacity )
 {
-    // check that src has commands
-    if ( src_cnt == 0 )
+    char** words;
+    token_kind* kinds;
+    int new_capacity = ( vec->capacity == 0 ? VECTOR_START_SIZE : vec->capacity );
+
+    // leave room for the NULL terminator
+    if( capacity + 1 <= vec->capacity )
         return SUCCESS;
 
-    int i, j, loc = (dest_cnt - 1) + (src_cnt - 1);
+    while( new_capacity < capacity + 1 )
+        new_capacity *= 2;
 
-    // start at the end of dest[], shifting every word up src_cnt indices
-    for( i = dest_cnt - 1; i > index; i--, loc-- )
+    if( ( words = (char**)realloc( vec->words, new_capacity * sizeof(char*) ) ) == NULL )
     {
-        if( add_string( dest[i], dest, loc ) == FAILURE )
-            return FAILURE;
+        fprintf( stderr, "Error: could not grow command to %d words\n", capacity );
+        return FAILURE;
     }
+    vec->words = words;
 
-    // starting at index, add the strings in src[] to dest[]
-    for( i = index, j = 0; i < index + src_cnt; i++, j++ )
+    if( ( kinds = (token_kind*)realloc( vec->kinds, new_capacity * sizeof(token_kind) ) ) == NULL )
     {
-        // free memory used from before
-        if( i < dest_cnt )
-            free( dest[i] );
-
-        // copy alias into cmds
-        if( add_string( src[j], dest, i ) == FAILURE )
-        {
-            fprintf( stderr, "Error: could not add %s to cmds\n", src[j] );
-            return FAILURE;
-        }
+        fprintf( stderr, "Error: could not grow command to %d words\n", capacity );
+        return FAILURE;
     }
-    
+    vec->kinds = kinds;
+    vec->capacity = new_capacity;
+
     return SUCCESS;
-}/* end merge_string_arrays() */
+} /* end reserve_strings() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: free_strings                                  */
+/*      Return type:   none                                          */
+/*      Parameter(s):                                                */
+/*          word_vector* vec: vector to free                         */
+/*                                                                   */
+/*      Description:                                                 */
+/*          frees the arrays held by vec, not the strings themselves.*/
+/*                                                                   */
+/*********************************************************************/
+void free_strings( word_vector* vec )
+{
+    free( vec->words );
+    free( vec->kinds );
+    vec->words = NULL;
+    vec->kinds = NULL;
+    vec->count = vec->capacity = 0;
+} /* end free_strings() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: shift_strings_down                            */
+/*      Function name: append_strings                                */
 /*      Return type:   int                                           */
 /*      Parameter(s):                                                */
-/*          char* arr[]: array of strings we are shifting            */
-/*          int* arr_cnt: count of strings in arr[]                  */
-/*          int index: start point in arr[] to begin shifting        */
-/*          int amount: amount of indices we are shifting them down  */
+/*          word_vector* dest: vector we are appending to            */
+/*          word_vector* src: vector we are copying words from       */
+/*          int first: index of the first word of src to copy        */
+/*          int count: number of words to copy                       */
 /*                                                                   */
 /*      Description:                                                 */
-/*          this shifts all the elements from index to max down      */
-/*          by amount in arr[]                                       */
+/*          appends count words of src to the end of dest. Only the  */
+/*          pointers are copied, and dest grows by doubling, so      */
+/*          building a vector this way is linear in its length.      */
 /*                                                                   */
 /*********************************************************************/
-int shift_strings_down( char* arr[], int* arr_cnt, int index, int amount )
+int append_strings( word_vector* dest, word_vector* src, int first, int count )
 {
-    // check that index is within arr_cnt
-    if( index >= *arr_cnt )
-    {
-        fprintf( stderr, "Error: shift_strings_down() - index (%d) > arr_cnt (%d)\n", index, *arr_cnt );
+    if( reserve_strings( dest, dest->count + count ) == FAILURE )
         return FAILURE;
-    } 
+
+    memcpy( &dest->words[dest->count], &src->words[first], count * sizeof(char*) );
+    memcpy( &dest->kinds[dest->count], &src->kinds[first], count * sizeof(token_kind) );
+
+    dest->count += count;
+    dest->words[dest->count] = NULL;
     
-    int i, j;
+    return SUCCESS;
+}/* end append_strings() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_substitution_end                         */
+/*      Return type:   int - index after it, -1 if it is not closed  */
+/*      Parameter(s):                                                */
+/*          const char* line: text the substitution is in            */
+/*          int pos: index of the '$' of "$(" or "${", or of the '`' */
+/*                                                                   */
+/*      Description:                                                 */
+/*          finds the ')' that closes "$(", the '}' that closes "${" */
+/*          or the '`' that closes '`'. Quotes, backslashes and      */
+/*          nested substitutions are skipped, so                     */
+/*          "$(echo ')' $(pwd))" ends at the last ')'.               */
+/*          A '$' not followed by '(' or '{' is only one character.  */
+/*                                                                   */
+/*********************************************************************/
+int find_substitution_end( const char* line, int pos )
+{
+    const char* end;
+    char open, close;
+    int depth = 1, in_double = F;
 
-    // move all elements down by amount, starting at arr[index]
-    for( i = index; i < *arr_cnt; i++ )
+    if( line[pos] == '`' )
     {
-        // free memory previously used
-        free( arr[i - amount] );
-    
-        // place arr[index] in arr[index - amount]
-        if( add_string( arr[i], arr, i - amount ) == FAILURE )
+        for( pos++; line[pos] != '`'; pos++ )
         {
-            fprintf( stderr, "Error: shift_strings_down() - could not move cmds[%d] (%s) to cmds[%d]\n", i, arr[i], i - amount );
-            return FAILURE;
+            if( line[pos] == '\0' || ( line[pos] == '\\' && line[++pos] == '\0' ) )
+                return -1;
         }
+        return pos + 1;
     }
 
-    // free/NULL strings after arr_cnt - amount
-    for( j = i - amount; j < i; j++ )
+    if( line[pos] != '$' || ( line[pos + 1] != '(' && line[pos + 1] != '{' ) )
+        return pos + 1;
+
+    open = line[pos + 1];
+    close = ( open == '(' ? ')' : '}' );
+
+    for( pos += 2; depth > 0; )
     {
-        free( arr[j] );
-        arr[j] = NULL;
+        switch( line[pos] )
+        {
+            case '\0':
+                return -1;
+            case '\\':
+                if( line[++pos] == '\0' )
+                    return -1;
+                pos++;
+                break;
+            case '\'':
+                // everything up to the closing quote is skipped
+                if( !in_double && ( end = strchr( &line[pos + 1], '\'' ) ) == NULL )
+                    return -1;
+                pos = ( in_double ? pos + 1 : (int)( end - line ) + 1 );
+                break;
+            case '\"':
+                in_double = !in_double;
+                pos++;
+                break;
+            case '$':
+            case '`':
+                if( ( pos = find_substitution_end( line, pos ) ) == -1 )
+                    return -1;
+                break;
+            default:
+                if( !in_double )
+                    depth += ( line[pos] == open ) - ( line[pos] == close );
+                pos++;
+                break;
+        }
     }
 
-    // reset arr_cnt
-    *arr_cnt -= amount; 
-
-    return SUCCESS;
-}/* end shift_strings_down() */
+    return pos;
+} /* end find_substitution_end() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*      Function name: hash_string                                   */
+/*      Return type:   uint64_t                                      */
+/*      Parameter(s):                                                */
+/*          const char* str: string to hash                          */
+/*          size_t* length: set to the length of str, may be NULL    */
+/*                                                                   */
+/*      Description:                                                 */
+/*          64 bit FNV-1a hash of str.                               */
 /*                                                                   */
 /*********************************************************************/
+uint64_t hash_string( const char* str, size_t* length )
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const char* c;
+
+    for( c = str; *c != '\0'; c++ )
+    {
+        hash ^= (unsigned char)*c;
+        hash *= 1099511628211ULL;
+    }
+
+    if( length != NULL )
+        *length = (size_t)( c - str );
+
+    return hash;
+} /* end hash_string() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: is_special_char                               */
-/*      Return type:   int                                           */
+/*      Function name: hash_bytes                                    */
+/*      Return type:   uint64_t                                      */
 /*      Parameter(s):                                                */
-/*          const char c: character being tested                     */
+/*          const char* str: characters to hash, not terminated      */
+/*          size_t length: number of characters                      */
 /*                                                                   */
 /*      Description:                                                 */
-/*          tests a character against some special characters the    */
-/*          parser should be able to detect                          */
+/*          same hash as hash_string(), for a name that is part of   */
+/*          a longer word, e.g. NAME in "NAME=value" or "$NAME/bin". */
 /*                                                                   */
 /*********************************************************************/
-static int is_special_char( const char c )
+uint64_t hash_bytes( const char* str, size_t length )
 {
-    return ( c == '$' || c == '|' || c == '<' || 
-             c == '>' || c == '&' || c == '?' ||
-             c == '!' || c == ',' || c == '=' || 
-             c == ':'
-           );
-} /* end is_special_char() */
+    uint64_t hash = 14695981039346656037ULL;
+    size_t i;
+
+    for( i = 0; i < length; i++ )
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 1099511628211ULL;
+    }
 
+    return hash;
+} /* end hash_bytes() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: save_word                                     */
-/*      Return type:   none                                          */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: save_token                                    */
+/*      Return type:   int                                           */
 /*      Parameter(s):                                                */
-/*          char* cmd: cmd we are adding                             */
-/*          char* cmds[]: where we are adding cmd to                 */
-/*          int* pos: position in cmds[] we are adding cmd           */
-/*          int* cmd_len: len of cmd                                 */
+/*          token_vector* tokens: where we are adding the token      */
+/*          int offset: start of the word in the line (-1 if none)   */
+/*          int length: length of the word                           */
+/*          token_kind kind: kind of word                            */
 /*                                                                   */
 /*      Description:                                                 */
-/*          used by parse_string function to save each word.         */
-/*          calls the add_string() function which does the memory    */
-/*          allocation and placement, this function more handles     */
-/*          the checks and resets of variables.                      */
-/*          It is done this way to modularize the code               */
+/*          used by tokenize_line function to save each word.        */
+/*          An empty word is kept, it comes from quotes ("").        */
+/*          tokens doubles in size when it is full.                  */
 /*                                                                   */
 /*********************************************************************/
-static void save_word( char* cmd, char* cmds[], int* pos, int* cmd_len )
+static int save_token( token_vector* tokens, int offset, int length, token_kind kind )
 {
-    // save word
-    if( *cmd_len > 0 )
+    token* grown;
+    int new_capacity;
+
+    if( offset == -1 )
+        return SUCCESS;
+
+    // grow tokens if needed
+    if( tokens->count == tokens->capacity )
     {
-        // add string to cmds[] and clear cmd
-        if( add_string( cmd, cmds, (*pos)++ ) == FAILURE )
+        new_capacity = ( tokens->capacity == 0 ? VECTOR_START_SIZE : tokens->capacity * 2 );
+
+        if( ( grown = (token*)realloc( tokens->tokens, new_capacity * sizeof(token) ) ) == NULL )
         {
-            fprintf( stderr, "Error: could not save word - %s\n", cmd );
-            return;
+            fprintf( stderr, "Error: could not grow command to %d words\n", new_capacity );
+            return FAILURE;
         }
-    
-        memset( &cmd[0], 0, WORD_LIMIT * sizeof(char) );
-        *cmd_len = 0;
+        tokens->tokens = grown;
+        tokens->capacity = new_capacity;
     }
-    return;
 
-} /* end is_special_char() */
+    tokens->tokens[tokens->count].offset = offset;
+    tokens->tokens[tokens->count].length = length;
+    tokens->tokens[tokens->count++].kind = kind;
+
+    return SUCCESS;
+} /* end save_token() */
@@ -13,19 +13,71 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include "arena_module.h"
+#include "scan_module.h"
 
 /* macros */
 #define FAILURE 0
 #define SUCCESS 1
-#define MAX_CMDS 250
-#define WORD_LIMIT 255
+#define VECTOR_START_SIZE 16
 #define T 1
 #define F 0
 
+/* kinds of tokens reported by the tokenizer,               */
+/* operators that separate commands come before redirects  */
+typedef enum token_kind_t
+{
+    TOKEN_WORD,
+    TOKEN_PIPE,             /* |            */
+    TOKEN_OR,               /* ||           */
+    TOKEN_BACKGROUND,       /* &            */
+    TOKEN_AND,              /* &&           */
+    TOKEN_SEMICOLON,        /* ;            */
+    TOKEN_REDIRECT_IN,      /* <   N<       */
+    TOKEN_REDIRECT_OUT,     /* >   N>       */
+    TOKEN_APPEND,           /* >>  N>>      */
+    TOKEN_DUP_IN,           /* <&M N<&M     */
+    TOKEN_DUP_OUT           /* >&M N>&M     */
+} token_kind;
+
+/* view of one word inside the line being tokenized */
+typedef struct token_t
+{
+    int         offset;
+    int         length;
+    token_kind  kind;
+} token;
+
+/* growable array of token views */
+typedef struct token_vector_t
+{
+    token*  tokens;
+    int     count;
+    int     capacity;
+} token_vector;
+
+/* growable array of words, words[count] is always NULL */
+typedef struct word_vector_t
+{
+    char**          words;
+    token_kind*     kinds;      /* kind of each word */
+    int             count;
+    int             capacity;
+} word_vector;
+
 /* function prototypes */
-int 	parse_string( char* line, char* cmds[], int* count );
+int 	parse_string( char* line, word_vector* cmds );
+int     parse_line_in_place( char* line, word_vector* cmds );
+int     tokenize_line( char* line, token_vector* tokens );
+int     terminate_tokens( char* line, token_vector* tokens, word_vector* cmds );
 int     add_string( char* str, char* arr[], int index );
-int     merge_string_arrays( char* dest[], int dest_cnt, char* src[], int src_cnt, int index );
-int     shift_strings_down( char* arr[], int* arr_cnt, int index, int amount );
+int     push_string( char* str, word_vector* vec );
+int     reserve_strings( word_vector* vec, int capacity );
+void    free_strings( word_vector* vec );
+int     append_strings( word_vector* dest, word_vector* src, int first, int count );
+int     find_substitution_end( const char* line, int pos );
+uint64_t hash_string( const char* str, size_t* length );
+uint64_t hash_bytes( const char* str, size_t length );
 
 #endif
@@ -0,0 +1,223 @@
+#include "substitution_module.h"
+
+/* static function prototypes */
+static int     runs_in_shell( command_list* list );
+static int     capture_builtin( command_list* list, char** output, size_t* length );
+static int     capture_process( char* line, char** output, size_t* length );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: capture_command                               */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* text: command line inside $(...)             */
+/*          size_t length: number of characters in text              */
+/*          char** output: set to what the command printed, must     */
+/*                         be freed by the caller                    */
+/*          size_t* output_length: set to the length of *output      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          runs text and collects its standard output, without the  */
+/*          newlines at the end. last_status is set to the exit      */
+/*          status of the command. FAILURE means the command could   */
+/*          not be run at all.                                       */
+/*                                                                   */
+/*********************************************************************/
+int capture_command( const char* text, size_t length, char** output, size_t* output_length )
+{
+    word_vector words = { NULL, NULL, 0, 0 };
+    command_list list;
+    char* line;
+    int result;
+
+    *output = NULL;
+    *output_length = 0;
+
+    if( ( line = arena_strndup( &line_arena, text, length ) ) == NULL )
+        return FAILURE;
+
+    // parse_string() leaves line alone for the child to run
+    if( parse_string( line, &words ) == FAILURE ||
+        ( words.count > 0 && parse_commands( &words, &list ) == FAILURE ) )
+    {
+        free_strings( &words );
+        last_status = 2;
+        return FAILURE;
+    }
+
+    if( words.count == 0 )
+        result = SUCCESS;
+    else if( runs_in_shell( &list ) )
+        result = capture_builtin( &list, output, output_length );
+    else
+        result = capture_process( line, output, output_length );
+
+    free_strings( &words );
+
+    // $(...) drops the newlines at the end of the output
+    while( *output_length > 0 && (*output)[*output_length - 1] == '\n' )
+        (*output_length)--;
+
+    return result;
+} /* end capture_command() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: runs_in_shell                                 */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          command_list* list: parsed text of the substitution      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          a single builtin that only prints, with no redirects,    */
+/*          assignments or alias, gives the same output whether it   */
+/*          runs in a child or not, so no child is needed.           */
+/*                                                                   */
+/*********************************************************************/
+static int runs_in_shell( command_list* list )
+{
+    command* cmd = &list->commands[0];
+
+    return ( list->n_pipelines == 1 && list->n_commands == 1 &&
+             cmd->n_assigns == 0 && cmd->n_redirects == 0 &&
+             builtin_is_pure( cmd->builtin ) &&
+             find_alias( list->words->words[list->args[cmd->first_arg]] ) == NULL );
+} /* end runs_in_shell() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: capture_builtin                               */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          command_list* list: a builtin runs_in_shell() accepted   */
+/*          char** output: set to what the builtin printed           */
+/*          size_t* length: set to the length of *output             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          runs the builtin in the shell, printing into a memory    */
+/*          stream instead of stdout.                                */
+/*                                                                   */
+/*********************************************************************/
+static int capture_builtin( command_list* list, char** output, size_t* length )
+{
+    command* cmd = &list->commands[0];
+    FILE* stream;
+
+    if( expand_pipeline( list, &list->pipelines[0] ) == FAILURE )
+    {
+        last_status = 1;
+        return FAILURE;
+    }
+
+    if( ( stream = open_memstream( output, length ) ) == NULL )
+    {
+        fprintf( stderr, "Error: could not capture the output of '%s'\n", list->expanded[0].argv[0] );
+        return FAILURE;
+    }
+
+    last_status = run_builtin( cmd->builtin, list->expanded[0].argc, list->expanded[0].argv, stream );
+    fclose( stream );
+
+    return SUCCESS;
+} /* end capture_builtin() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: capture_process                               */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          char* line: command line to run                          */
+/*          char** output: set to what the commands printed          */
+/*          size_t* length: set to the length of *output             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          runs line in a child with stdout going into a pipe, and  */
+/*          reads the pipe into a buffer that doubles as it fills,   */
+/*          asking for SUBST_READ_SIZE bytes at a time.              */
+/*                                                                   */
+/*********************************************************************/
+static int capture_process( char* line, char** output, size_t* length )
+{
+    int fd[2], status = 0;
+    size_t capacity = 0;
+    ssize_t n;
+    char* grown;
+    pid_t pid;
+    void (*istat)(int), (*qstat)(int);
+
+    if( pipe( fd ) == -1 )
+    {
+        fprintf( stderr, "Error: could not create pipe for command substitution\n" );
+        return FAILURE;
+    }
+
+    // anything still buffered would be written again by the child
+    fflush( stdout );
+
+    if( ( pid = fork() ) == 0 )
+    {
+        close( fd[READ_END] );
+        dup2( fd[WRITE_END], STDOUT_FILENO );
+        close( fd[WRITE_END] );
+
+        // the words of the line being expanded are of no use here
+        cmds.count = 0;
+        process_commands( line );
+
+        fflush( stdout );
+        _exit( last_status );
+    }
+
+    close( fd[WRITE_END] );
+
+    if( pid < 0 )
+    {
+        fprintf( stderr, "Error: could not fork() for command substitution\n" );
+        close( fd[READ_END] );
+        return FAILURE;
+    }
+
+    // same as waiting for any other child, ctrl-c is for it
+    istat = signal( SIGINT, SIG_IGN );
+    qstat = signal( SIGQUIT, SIG_IGN );
+
+    do
+    {
+        if( capacity - *length < SUBST_READ_SIZE )
+        {
+            capacity = ( capacity == 0 ? SUBST_READ_SIZE : capacity * 2 );
+            if( ( grown = (char*)realloc( *output, capacity ) ) == NULL )
+            {
+                fprintf( stderr, "Error: could not grow command output to %zu bytes\n", capacity );
+                break;
+            }
+            *output = grown;
+        }
+
+        n = read( fd[READ_END], *output + *length, capacity - *length );
+        if( n > 0 )
+            *length += (size_t)n;
+    } while( n > 0 || ( n == -1 && errno == EINTR ) );
+
+    close( fd[READ_END] );
+
+    while( waitpid( pid, &status, 0 ) == -1 && errno == EINTR )
+        continue;
+
+    signal( SIGINT, istat );
+    signal( SIGQUIT, qstat );
+
+    last_status = ( WIFEXITED( status ) ? WEXITSTATUS( status ) : 128 + WTERMSIG( status ) );
+
+    return SUCCESS;
+} /* end capture_process() */
@@ -0,0 +1,46 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: substitution_module.h                       */
+/*          Description:                                             */
+/*              This module runs the command inside $(...) or        */
+/*              backticks and hands back what it printed. A builtin  */
+/*              that only prints runs in the shell itself, anything  */
+/*              else runs in a child whose output is read through a  */
+/*              pipe, so no temporary files are needed.              */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef SUBSTITUTION_MODULE_H
+#define SUBSTITUTION_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "string_module.h"
+#include "parse_module.h"
+#include "arena_module.h"
+#include "alias_module.h"
+#include "execution_module.h"
+#include "expansion_module.h"
+
+/* macros */
+#define SUBST_READ_SIZE 65536   /* bytes asked for by each read() */
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* defined by the shell */
+extern int process_commands( char* line );
+
+/* function prototypes */
+int     capture_command( const char* text, size_t length, char** output, size_t* output_length );
+
+#endif
@@ -0,0 +1,239 @@
+#include "table_module.h"
+
+/* static function prototypes */
+static size_t      find_slot( const hash_table* t, const char* key, size_t length, uint64_t hash );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: table_get                                     */
+/*      Return type:   void* - entry with key, NULL if none          */
+/*      Parameter(s):                                                */
+/*          const hash_table* t: table to look in                    */
+/*          const char* key: key to find, need not be terminated     */
+/*          size_t length: length of key                             */
+/*          uint64_t hash: hash of key                               */
+/*                                                                   */
+/*********************************************************************/
+void* table_get( const hash_table* t, const char* key, size_t length, uint64_t hash )
+{
+    if( t->count == 0 )
+        return NULL;
+
+    return t->slots[find_slot( t, key, length, hash )];
+} /* end table_get() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: table_put                                     */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          hash_table* t: table to add to                           */
+/*          void* entry: entry to add                                */
+/*          const char* key: key of entry                            */
+/*          size_t length: length of key                             */
+/*          uint64_t hash: hash of key                               */
+/*          void** replaced: set to the entry with the same key it   */
+/*                           replaced, NULL if none                  */
+/*                                                                   */
+/*      Description:                                                 */
+/*          adds entry, growing the table first if it would be more  */
+/*          than half full. The entry replaced is the caller's to    */
+/*          free, as entry is on failure.                            */
+/*                                                                   */
+/*********************************************************************/
+int table_put( hash_table* t, void* entry, const char* key, size_t length, uint64_t hash, void** replaced )
+{
+    size_t i;
+
+    *replaced = NULL;
+
+    // keep the table at most half full so probes stay short
+    if( table_reserve( t, t->count + 1 ) == FAILURE )
+        return FAILURE;
+
+    i = find_slot( t, key, length, hash );
+    if( ( *replaced = t->slots[i] ) == NULL )
+        t->count++;
+
+    t->slots[i] = entry;
+    t->hashes[i] = hash;
+
+    return SUCCESS;
+} /* end table_put() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: table_remove                                  */
+/*      Return type:   void* - entry removed, NULL if none           */
+/*      Parameter(s):                                                */
+/*          hash_table* t: table to remove from                      */
+/*          const char* key: key of the entry                        */
+/*          size_t length: length of key                             */
+/*          uint64_t hash: hash of key                               */
+/*                                                                   */
+/*      Description:                                                 */
+/*          takes the entry out of the table and moves later entries */
+/*          of the same probe run back into the hole, so lookups     */
+/*          never need markers for removed entries. The entry is     */
+/*          the caller's to free.                                    */
+/*                                                                   */
+/*********************************************************************/
+void* table_remove( hash_table* t, const char* key, size_t length, uint64_t hash )
+{
+    size_t mask = t->capacity - 1, i, j, home;
+    void* entry;
+
+    if( t->count == 0 )
+        return NULL;
+
+    i = find_slot( t, key, length, hash );
+    if( ( entry = t->slots[i] ) == NULL )
+        return NULL;
+
+    t->slots[i] = NULL;
+    t->count--;
+
+    // shift back every entry after the hole that may not skip it
+    for( j = i; ; )
+    {
+        j = ( j + 1 ) & mask;
+        if( t->slots[j] == NULL )
+            break;
+
+        // an entry can fill the hole unless its home slot is between
+        // the hole and where it is now
+        home = t->hashes[j] & mask;
+        if( ( j > i && ( home <= i || home > j ) ) || ( j < i && home <= i && home > j ) )
+        {
+            t->slots[i] = t->slots[j];
+            t->hashes[i] = t->hashes[j];
+            t->slots[j] = NULL;
+            i = j;
+        }
+    }
+
+    return entry;
+} /* end table_remove() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: table_reserve                                 */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          hash_table* t: table to grow                             */
+/*          size_t count: entries the table must have room for       */
+/*                                                                   */
+/*      Description:                                                 */
+/*          doubles the number of slots until count entries fill at  */
+/*          most half of them, then places every entry again using   */
+/*          the hash stored with it. Does nothing if they already    */
+/*          fit, so a table can be sized once before it is filled.   */
+/*                                                                   */
+/*********************************************************************/
+int table_reserve( hash_table* t, size_t count )
+{
+    size_t i, j, mask, new_capacity = ( t->capacity == 0 ? t->start_size : t->capacity );
+    uint64_t* hashes;
+    void** slots;
+
+    if( count * 2 <= t->capacity )
+        return SUCCESS;
+
+    while( count * 2 > new_capacity )
+        new_capacity *= 2;
+
+    slots = (void**)calloc( new_capacity, sizeof(void*) );
+    hashes = (uint64_t*)malloc( new_capacity * sizeof(uint64_t) );
+    if( slots == NULL || hashes == NULL )
+    {
+        fprintf( stderr, "Error: could not grow %s table to %zu slots\n", t->what, new_capacity );
+        free( slots );
+        free( hashes );
+        return FAILURE;
+    }
+    mask = new_capacity - 1;
+
+    for( i = 0; i < t->capacity; i++ )
+    {
+        if( t->slots[i] == NULL )
+            continue;
+
+        for( j = t->hashes[i] & mask; slots[j] != NULL; j = ( j + 1 ) & mask )
+            continue;
+        slots[j] = t->slots[i];
+        hashes[j] = t->hashes[i];
+    }
+
+    free( t->slots );
+    free( t->hashes );
+    t->slots = slots;
+    t->hashes = hashes;
+    t->capacity = new_capacity;
+
+    return SUCCESS;
+} /* end table_reserve() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: table_free                                    */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          hash_table* t: table to empty                            */
+/*                                                                   */
+/*      Description:                                                 */
+/*          frees every entry and the slots. The table can be filled */
+/*          again afterwards.                                        */
+/*                                                                   */
+/*********************************************************************/
+void table_free( hash_table* t )
+{
+    size_t i;
+
+    for( i = 0; i < t->capacity; i++ )
+        free( t->slots[i] );
+
+    free( t->slots );
+    free( t->hashes );
+    t->slots = NULL;
+    t->hashes = NULL;
+    t->capacity = t->count = 0;
+} /* end table_free() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: find_slot                                     */
+/*      Return type:   size_t - slot holding key, or the empty slot  */
+/*                     where it would go                             */
+/*      Parameter(s):                                                */
+/*          const hash_table* t: table to look in, with slots        */
+/*          const char* key: key to find, need not be terminated     */
+/*          size_t length: length of key                             */
+/*          uint64_t hash: hash of key                               */
+/*                                                                   */
+/*      Description:                                                 */
+/*          linear probing from the slot hash points to. The table   */
+/*          is never full, so an empty slot is always found. Only an */
+/*          entry with the same hash is compared with the key.       */
+/*                                                                   */
+/*********************************************************************/
+static size_t find_slot( const hash_table* t, const char* key, size_t length, uint64_t hash )
+{
+    size_t mask = t->capacity - 1, i = hash & mask;
+
+    while( t->slots[i] != NULL && ( t->hashes[i] != hash || !t->match( t->slots[i], key, length ) ) )
+        i = ( i + 1 ) & mask;
+
+    return i;
+} /* end find_slot() */
@@ -0,0 +1,53 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: table_module.h                              */
+/*          Description:                                             */
+/*              This module provides the open addressing hash table  */
+/*              behind aliases, variables and programs found in      */
+/*              $PATH. Entries are found by linear probing, the      */
+/*              table doubles before it gets more than half full,    */
+/*              and removing an entry moves later ones back so no    */
+/*              markers are left behind. The table only keeps        */
+/*              pointers and hashes, each module says how a key is   */
+/*              compared with one of its entries.                    */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef TABLE_MODULE_H
+#define TABLE_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* T if entry has the key of length bytes */
+typedef int (*table_match)( const void* entry, const char* key, size_t length );
+
+/* structure to hold the table */
+typedef struct hash_table_t
+{
+    void**      slots;          /* NULL when empty                  */
+    uint64_t*   hashes;         /* hash of the key of each entry    */
+    size_t      capacity;       /* power of 2                       */
+    size_t      count;
+    size_t      start_size;     /* slots at first, a power of 2     */
+    const char* what;           /* what the entries are, for errors */
+    table_match match;
+} hash_table;
+
+/* function prototypes */
+void*   table_get( const hash_table* t, const char* key, size_t length, uint64_t hash );
+int     table_put( hash_table* t, void* entry, const char* key, size_t length, uint64_t hash, void** replaced );
+void*   table_remove( hash_table* t, const char* key, size_t length, uint64_t hash );
+int     table_reserve( hash_table* t, size_t count );
+void    table_free( hash_table* t );
+
+#endif
@@ -0,0 +1,493 @@
+#include "variable_module.h"
+
+/* static function prototypes */
+static variable*   store_variable( const char* name, size_t length, const char* value, int exported );
+static int         match_variable( const void* entry, const char* name, size_t length );
+static int         variable_cmp( const void* v1, const void* v2 );
+
+/* globals */
+static hash_table       table = { NULL, NULL, 0, 0, VARIABLE_START_SIZE, "variable", match_variable };
+static environment      env_cache = { NULL, 0, 0, 0 };
+unsigned long variable_generation = 1;
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: init_variables                                */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          char** env: environment the shell was started with       */
+/*                                                                   */
+/*      Description:                                                 */
+/*          adds every "NAME=value" of env as an exported variable.  */
+/*          The table is sized for env up front so it does not grow  */
+/*          while it is filled.                                      */
+/*                                                                   */
+/*********************************************************************/
+int init_variables( char** env )
+{
+    char* equals;
+    int i;
+
+    for( i = 0; env[i] != NULL; i++ )
+        continue;
+
+    if( table_reserve( &table, (size_t)i + 1 ) == FAILURE )
+        return FAILURE;
+
+    for( i = 0; env[i] != NULL; i++ )
+    {
+        if( ( equals = strchr( env[i], '=' ) ) == NULL || equals == env[i] )
+            continue;
+
+        if( store_variable( env[i], (size_t)( equals - env[i] ), equals + 1, T ) == NULL )
+            return FAILURE;
+    }
+
+    return SUCCESS;
+} /* end init_variables() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: get_variable                                  */
+/*      Return type:   const char* - value, NULL if not set          */
+/*      Parameter(s):                                                */
+/*          const char* name: name of the variable                   */
+/*                                                                   */
+/*********************************************************************/
+const char* get_variable( const char* name )
+{
+    return get_variable_n( name, strlen( name ) );
+} /* end get_variable() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: get_variable_n                                */
+/*      Return type:   const char* - value, NULL if not set          */
+/*      Parameter(s):                                                */
+/*          const char* name: name of the variable, not terminated   */
+/*          size_t length: length of name                            */
+/*                                                                   */
+/*      Description:                                                 */
+/*          looks up a name that is part of a longer word, e.g. the  */
+/*          HOME in "$HOME/bin", without copying it out first.       */
+/*                                                                   */
+/*********************************************************************/
+const char* get_variable_n( const char* name, size_t length )
+{
+    variable* v;
+
+    if( table.count == 0 )
+        return NULL;
+
+    v = (variable*)table_get( &table, name, length, hash_bytes( name, length ) );
+    return ( v == NULL ? NULL : v->value );
+} /* end get_variable_n() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: set_variable                                  */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* name: name of the variable, not terminated   */
+/*          size_t length: length of name                            */
+/*          const char* value: new value                             */
+/*          variable_scope scope: VAR_EXPORT to export it, VAR_KEEP  */
+/*                                to leave the export flag as is     */
+/*                                                                   */
+/*      Description:                                                 */
+/*          adds or replaces a variable. Changing an exported one    */
+/*          means the environment of programs has to be rebuilt.     */
+/*                                                                   */
+/*********************************************************************/
+int set_variable( const char* name, size_t length, const char* value, variable_scope scope )
+{
+    variable* v, * old;
+    int exported;
+
+    old = (variable*)table_get( &table, name, length, hash_bytes( name, length ) );
+    exported = ( scope == VAR_EXPORT || ( old != NULL && old->exported ) );
+
+    // value may point into the old variable, it is freed afterwards
+    if( ( v = store_variable( name, length, value, exported ) ) == NULL )
+        return FAILURE;
+
+    if( exported )
+        variable_generation++;
+
+    return SUCCESS;
+} /* end set_variable() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: export_variable                               */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* name: name of the variable                   */
+/*                                                                   */
+/*      Description:                                                 */
+/*          passes a shell variable on to programs. Exporting a      */
+/*          name that is not set does nothing.                       */
+/*                                                                   */
+/*********************************************************************/
+int export_variable( const char* name )
+{
+    size_t length = strlen( name );
+    variable* v;
+
+    if( ( v = (variable*)table_get( &table, name, length, hash_bytes( name, length ) ) ) == NULL || v->exported )
+        return SUCCESS;
+
+    v->exported = T;
+    variable_generation++;
+
+    return SUCCESS;
+} /* end export_variable() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: unset_variable                                */
+/*      Return type:   int (SUCCESS/FAILURE)                         */
+/*      Parameter(s):                                                */
+/*          const char* name: name of the variable                   */
+/*                                                                   */
+/*      Description:                                                 */
+/*          removes a variable. Unsetting a name that is not set is  */
+/*          not an error.                                            */
+/*                                                                   */
+/*********************************************************************/
+int unset_variable( const char* name )
+{
+    size_t length = strlen( name );
+    variable* v;
+
+    if( ( v = (variable*)table_remove( &table, name, length, hash_bytes( name, length ) ) ) == NULL )
+        return SUCCESS;
+
+    if( v->exported )
+        variable_generation++;
+
+    free( v );
+
+    return SUCCESS;
+} /* end unset_variable() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: get_environment                               */
+/*      Return type:   char** - NULL terminated, NULL on failure     */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          returns the exported variables as the envp execve()      */
+/*          wants. The array points at the "NAME=value" of each      */
+/*          variable and is only rebuilt after export, unset or an   */
+/*          assignment changed an exported variable, every other     */
+/*          program started reuses it as is.                         */
+/*                                                                   */
+/*********************************************************************/
+char** get_environment( void )
+{
+    char** entries;
+    variable* v;
+    size_t i, n = 0;
+
+    if( env_cache.generation == variable_generation && env_cache.entries != NULL )
+        return env_cache.entries;
+
+    // room for every variable, so the array only grows with the table
+    if( env_cache.capacity < table.count + 1 )
+    {
+        if( ( entries = (char**)realloc( env_cache.entries, ( table.count + 1 ) * sizeof(char*) ) ) == NULL )
+        {
+            fprintf( stderr, "Error: could not allocate memory for the environment\n" );
+            return NULL;
+        }
+        env_cache.entries = entries;
+        env_cache.capacity = table.count + 1;
+    }
+
+    for( i = 0; i < table.capacity; i++ )
+    {
+        if( ( v = (variable*)table.slots[i] ) != NULL && v->exported )
+        {
+            v->env_index = n;
+            env_cache.entries[n++] = v->entry;
+        }
+    }
+    env_cache.entries[n] = NULL;
+    env_cache.count = n;
+    env_cache.generation = variable_generation;
+
+    return env_cache.entries;
+} /* end get_environment() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: overlay_environment                           */
+/*      Return type:   char** - NULL terminated, NULL on failure     */
+/*      Parameter(s):                                                */
+/*          char** assigns: "NAME=value" words, already expanded     */
+/*          int n: number of words in assigns                        */
+/*                                                                   */
+/*      Description:                                                 */
+/*          envp for "NAME=value prog". Only the pointer array of    */
+/*          get_environment() is copied, into line_arena, then the   */
+/*          entries of the names in assigns are swapped for the      */
+/*          words themselves or added at the end. No string is       */
+/*          copied and the shell's own variables do not change.      */
+/*                                                                   */
+/*********************************************************************/
+char** overlay_environment( char** assigns, int n )
+{
+    char** base = get_environment(), ** envp;
+    size_t count = env_cache.count, length, j;
+    variable* v;
+    int i;
+
+    if( base == NULL || n == 0 )
+        return base;
+
+    if( ( envp = (char**)arena_alloc( &line_arena, ( count + n + 1 ) * sizeof(char*) ) ) == NULL )
+    {
+        fprintf( stderr, "Error: could not allocate memory for the environment\n" );
+        return NULL;
+    }
+    memcpy( envp, base, count * sizeof(char*) );
+
+    for( i = 0; i < n; i++ )
+    {
+        length = (size_t)( strchr( assigns[i], '=' ) - assigns[i] );
+        v = (variable*)table_get( &table, assigns[i], length, hash_bytes( assigns[i], length ) );
+
+        // an exported variable has its own entry already
+        if( v != NULL && v->exported )
+        {
+            envp[v->env_index] = assigns[i];
+            continue;
+        }
+
+        // the same name twice in assigns, the last one wins
+        for( j = env_cache.count; j < count; j++ )
+        {
+            if( strncmp( envp[j], assigns[i], length + 1 ) == 0 )
+                break;
+        }
+        envp[j] = assigns[i];
+        if( j == count )
+            count++;
+    }
+    envp[count] = NULL;
+
+    return envp;
+} /* end overlay_environment() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: print_variables                               */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          FILE* out: where to print                                */
+/*                                                                   */
+/*      Description:                                                 */
+/*          prints every exported variable sorted by name, the way   */
+/*          "export" without arguments does in other shells.         */
+/*                                                                   */
+/*********************************************************************/
+void print_variables( FILE* out )
+{
+    variable** sorted, * v;
+    size_t i, n = 0;
+
+    if( table.count == 0 )
+        return;
+
+    if( ( sorted = (variable**)malloc( table.count * sizeof(variable*) ) ) == NULL )
+    {
+        fprintf( stderr, "Error: could not allocate memory to sort variables\n" );
+        return;
+    }
+
+    for( i = 0; i < table.capacity; i++ )
+    {
+        if( ( v = (variable*)table.slots[i] ) != NULL && v->exported )
+            sorted[n++] = v;
+    }
+
+    qsort( sorted, n, sizeof(variable*), variable_cmp );
+
+    for( i = 0; i < n; i++ )
+        fprintf( out, "export %s\n", sorted[i]->entry );
+
+    free( sorted );
+    return;
+} /* end print_variables() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: free_variables                                */
+/*      Return type:   void                                          */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*********************************************************************/
+void free_variables( void )
+{
+    table_free( &table );
+
+    free( env_cache.entries );
+    env_cache.entries = NULL;
+    env_cache.count = env_cache.capacity = 0;
+    env_cache.generation = 0;
+    variable_generation++;
+
+    return;
+} /* end free_variables() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: variable_name_length                          */
+/*      Return type:   size_t - 0 if str does not start with a name  */
+/*      Parameter(s):                                                */
+/*          const char* str: text starting with a variable name      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          a name is a letter or '_' followed by letters, digits    */
+/*          and '_', e.g. "HOME" in "HOME/bin" or "x" in "x=1".      */
+/*                                                                   */
+/*********************************************************************/
+size_t variable_name_length( const char* str )
+{
+    size_t n;
+
+    if( !isalpha( (unsigned char)str[0] ) && str[0] != '_' )
+        return 0;
+
+    for( n = 1; isalnum( (unsigned char)str[n] ) || str[n] == '_'; n++ )
+        continue;
+
+    return n;
+} /* end variable_name_length() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: is_assignment                                 */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          const char* word: word as the lexer found it             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          checks for "NAME=value". Only the name has to be plain,  */
+/*          the value may be quoted, e.g. x="a b".                   */
+/*                                                                   */
+/*********************************************************************/
+int is_assignment( const char* word )
+{
+    size_t n = variable_name_length( word );
+
+    return ( n > 0 && word[n] == '=' );
+} /* end is_assignment() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: store_variable                                */
+/*      Return type:   variable* - NULL on failure                   */
+/*      Parameter(s):                                                */
+/*          const char* name: name of the variable, not terminated   */
+/*          size_t length: length of name                            */
+/*          const char* value: value of the variable                 */
+/*          int exported: T if programs get the variable             */
+/*                                                                   */
+/*      Description:                                                 */
+/*          copies the name, "NAME=value" and the flags into one     */
+/*          block and puts it in the table, replacing the variable   */
+/*          of the same name if there is one.                        */
+/*                                                                   */
+/*********************************************************************/
+static variable* store_variable( const char* name, size_t length, const char* value, int exported )
+{
+    size_t value_len = strlen( value );
+    variable* v;
+    void* old;
+
+    if( ( v = (variable*)malloc( sizeof(variable) + 2 * length + value_len + 3 ) ) == NULL )
+    {
+        fprintf( stderr, "Error: could not allocate memory for variable %.*s\n", (int)length, name );
+        return NULL;
+    }
+
+    v->name_len = length;
+    v->exported = exported;
+
+    // the name on its own, then "NAME=value"
+    v->name = (char*)( v + 1 );
+    memcpy( v->name, name, length );
+    v->name[length] = '\0';
+
+    v->entry = v->name + length + 1;
+    memcpy( v->entry, name, length );
+    v->entry[length] = '=';
+    v->value = v->entry + length + 1;
+    memcpy( v->value, value, value_len + 1 );
+
+    if( table_put( &table, v, v->name, length, hash_bytes( name, length ), &old ) == FAILURE )
+    {
+        free( v );
+        return NULL;
+    }
+    free( old );
+
+    return v;
+} /* end store_variable() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: match_variable                                */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          const void* entry: variable in the table                 */
+/*          const char* name: name to find, not terminated           */
+/*          size_t length: length of name                            */
+/*                                                                   */
+/*********************************************************************/
+static int match_variable( const void* entry, const char* name, size_t length )
+{
+    const variable* v = (const variable*)entry;
+
+    return ( v->name_len == length && memcmp( v->name, name, length ) == 0 );
+} /* end match_variable() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: variable_cmp                                  */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          v1: pointer to first variable pointer.                   */
+/*          v2: pointer to second variable pointer.                  */
+/*      Description:                                                 */
+/*          used to compare variables for qsort.                     */
+/*                                                                   */
+/*********************************************************************/
+static int variable_cmp( const void* v1, const void* v2 )
+{
+    return strcmp( (*(variable* const*)v1)->name, (*(variable* const*)v2)->name );
+} /* end variable_cmp() */
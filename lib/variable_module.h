@@ -0,0 +1,80 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Module name: variable_module.h                           */
+/*          Description:                                             */
+/*              This module stores the shell's variables in an open  */
+/*              addressing hash table, filled from environ when the  */
+/*              shell starts. Variables set with "x=1" stay in the   */
+/*              shell, exported ones are also passed to programs     */
+/*              through an envp that is only rebuilt after one of    */
+/*              them changed.                                        */
+/*                                                                   */
+/*********************************************************************/
+
+#ifndef VARIABLE_MODULE_H
+#define VARIABLE_MODULE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include "string_module.h"
+#include "table_module.h"
+
+#define VARIABLE_START_SIZE 64  /* slots, must be a power of 2 */
+
+#ifndef FAILURE
+    #define FAILURE 0
+#endif
+#ifndef SUCCESS
+    #define SUCCESS 1
+#endif
+
+/* how set_variable() treats the export flag */
+typedef enum variable_scope_t
+{
+    VAR_KEEP,       /* exported only if it already was */
+    VAR_EXPORT
+} variable_scope;
+
+/* one variable, the name and "NAME=value" follow it in memory */
+typedef struct variable_t
+{
+    char*       name;
+    char*       entry;      /* "NAME=value", as programs get it  */
+    char*       value;      /* points just past the '='          */
+    size_t      name_len;
+    int         exported;
+    size_t      env_index;  /* where entry is in the environment */
+} variable;
+
+/* exported variables as execve() wants them, rebuilt only when */
+/* variable_generation moved since the last time                */
+typedef struct environment_t
+{
+    char**          entries;    /* NULL terminated               */
+    size_t          count;
+    size_t          capacity;
+    unsigned long   generation;
+} environment;
+
+/* globals */
+extern unsigned long variable_generation;   /* bumped when an exported */
+                                            /* variable changes        */
+
+/* prototypes */
+int         init_variables( char** env );
+const char* get_variable( const char* name );
+const char* get_variable_n( const char* name, size_t length );
+int         set_variable( const char* name, size_t length, const char* value, variable_scope scope );
+int         export_variable( const char* name );
+int         unset_variable( const char* name );
+char**      get_environment( void );
+char**      overlay_environment( char** assigns, int n );
+void        print_variables( FILE* out );
+void        free_variables( void );
+size_t      variable_name_length( const char* str );
+int         is_assignment( const char* word );
+
+#endif
@@ -20,7 +20,6 @@
     // 5) add any other features you think of! :D
     // 6) make sure memory leaks don't exist
 
-    // CLEARLY DEFINE WHAT A WORD IS INTERPRETTED AS BY THE PROGRAM IN THE README
     // state how input/output redirects work CLEARLY - can only do one at a time or both at once, but cannot output redirect twice or input redirect twice in one command
 
 // standard libraries 
@@ -36,12 +35,18 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <limits.h>
 
 // for custom libraries 
 #include "../lib/alias_module.h"
 #include "../lib/string_module.h"
 #include "../lib/history_module.h"
+#include "../lib/search_module.h"
 #include "../lib/execution_module.h"
+#include "../lib/parse_module.h"
+#include "../lib/cache_module.h"
+#include "../lib/expansion_module.h"
+#include "../lib/option_module.h"
 
 // macros
 #define PROMPT_SIZE 255
@@ -52,42 +57,51 @@
 #define HOST "HOST"
 
 // global variables 
-char*   cmds[MAX_CMDS]; 
-int     n_cmds = 0; 
-char    previous_dir[WORD_LIMIT] = "";
+extern char** environ;
+word_vector cmds = { NULL, NULL, 0, 0 };
+word_vector alias_cmds = { NULL, NULL, 0, 0 };  /* cmds with aliases expanded */
+char    previous_dir[PATH_MAX] = "";
+int     last_status = 0;
 
 // utility function prototypes 
 void    start_shell( void );
-int     process_commands( void );
+int     process_commands( char* line );
+int     run_builtin( builtin_id id, int argc, char** argv, FILE* out );
 
 // history handling 
-int     handle_history( void );
+int     handle_history( int argc, char** argv, FILE* out );
 
 // alias handling 
-int     handle_aliases( void );
+int     handle_aliases( int argc, char** argv, FILE* out );
+int     handle_unalias( int argc, char** argv, FILE* out );
 int     check_for_alias( void );
 
-// env variable handling 
-int     handle_env_vars( void );
-int     convert_env_var( int index );
-int     check_for_var_in_quotes( int i );
+// variable handling 
+int     handle_export( int argc, char** argv, FILE* out );
+int     handle_unset( int argc, char** argv, FILE* out );
 
-// directory change handling 
-int     handle_directory_change( void );
-int     change_to_home_dir( void );
-int     change_to_prev_dir( void );
-int     change_dir( void );
-int     translate_dir_path( int loc );
+// printing 
+int     handle_echo( int argc, char** argv, FILE* out );
+int     handle_pwd( int argc, char** argv, FILE* out );
+
+// option handling 
+int     handle_set( int argc, char** argv, FILE* out );
 
-// program execution function prototypes 
-int     handle_program_execution( void );
+// program lookup handling 
+int     handle_hash( int argc, char** argv, FILE* out );
+
+// directory change handling 
+int     handle_directory_change( int argc, char** argv, FILE* out );
+int     change_to_home_dir( FILE* out );
+int     change_to_prev_dir( FILE* out );
+int     change_dir( const char* dir, FILE* out );
+int     translate_dir_path( char* path, int loc );
 
 // helper function (low level) 
 int     is_directory( const char* dirname );
+const char* current_dir( void );
 int     is_reg_file( const char* filename );
-int     is_redirect( const char type );
 void    print_commands( void );
-int     count_pipes( void );
 
 
 /*********************************************************************/
@@ -101,6 +115,18 @@ int     count_pipes( void );
 /*********************************************************************/
 int main( void )
 {
+    scan_init();
+
+    // every variable lookup goes through the table from here on
+    if( init_variables( environ ) == FAILURE )
+        return EXIT_FAILURE;
+
+    // without the file, history is only kept in memory
+    init_history();
+
+    // Ctrl-R, the index is only built once it is used
+    init_search();
+
     start_shell();
     return EXIT_SUCCESS;
 } /* end main */
@@ -121,20 +147,19 @@ void start_shell( void )
 {
     char prompt[PROMPT_SIZE];
     char* line = NULL;
-    int i;
-    
-    // initialize cmds to NULL
-    for( i = 0; i < MAX_CMDS; i++ )
-        cmds[i] = NULL;
+    const char* user, * host, * pwd;
 
     // begin infinite loop that is the shell 
     while ( 1 )
     {
         // set prompt to display proper information each time
+        user = get_variable( USER );
+        host = get_variable( HOST );
+        pwd = get_variable( PWD );
         sprintf( prompt, "\033[1;36m%s\033[1;35m@\033[1;33m%s \033[1;32m[%s]> \033[0m",
-            ( getenv( USER ) == NULL ? "UnknownUser" : getenv( USER ) ),
-            ( getenv( HOST ) == NULL ? "UnknownHost" : getenv( HOST ) ),
-            ( getenv( PWD ) == NULL ? "UnknownDirectory" : getenv( PWD ) ) );
+            ( user == NULL ? "UnknownUser" : user ),
+            ( host == NULL ? "UnknownHost" : host ),
+            ( pwd == NULL ? "UnknownDirectory" : pwd ) );
 
         // prompt then read line - line is allocated with malloc(3) 
         line = readline(prompt);
@@ -143,25 +168,41 @@ void start_shell( void )
         if ( strcmp( line, "exit" ) == 0 )
         {
             free( line );
+            free_search();
             free_history();
+            free_strings( &cmds );
+            free_strings( &alias_cmds );
+            cache_clear();
+            free_aliases();
+            free_expansion();
+            clear_programs();
+            free_variables();
+            arena_free( &line_arena );
             return;
         }
-        else if( parse_string( line, cmds, &n_cmds ) == FAILURE )
-            ; 
-        else if(n_cmds > 0)
-            process_commands();
 
-        // add command to history
-        add_to_history( line );
-
-        // free all memory and reset n_cmds
-        for ( int i = 0; i < n_cmds; i++ )
+        // !! and !n are replaced before anything else sees the line
+        if( expand_history( &line ) == FAILURE )
         {
-            free( cmds[i] );
-            cmds[i] = NULL;
+            last_status = 1;
+            free( line );
+            continue;
         }
+
+        // add command to history, before the parser writes into line
+        add_to_history( line );
+
+        // words in cmds.words[] point into line or into the cache
+        process_commands( line );
+
+        // the command goes to the history file with its exit status
+        log_history( last_status );
+
+        // free every word of this line at once and reset cmds.count
+        release_aliases();
+        arena_reset( &line_arena );
         free( line );
-        n_cmds = 0;
+        cmds.count = 0;
     }
 
     return;
@@ -172,429 +213,651 @@ void start_shell( void )
 /*                                                                   */
 /*      Function name: process_commands                              */
 /*      Return type:   int                                           */
-/*      Parameter(s):  none                                          */
+/*      Parameter(s):                                                */
+/*          char* line: line the user entered, the lexer writes      */
+/*                      into it                                      */
 /*                                                                   */
 /*      Description:                                                 */
-/*          Handles parsed commands for appropriate processing.      */
+/*          Splits line into cmds, expands aliases and parses cmds   */
+/*          into pipelines, unless the cache already has the line.   */
+/*          Then runs the pipelines in order. && runs the next       */
+/*          pipeline only if the last one succeeded, || only if it   */
+/*          failed.                                                  */
 /*                                                                   */
 /*********************************************************************/
-int process_commands( void )
+int process_commands( char* line )
 {
-    /* error checking */
-    if( n_cmds == 0 )
+    command_list list;
+    pipeline* pl;
+    char* raw;
+    int i;
+
+    // a line entered before is already parsed
+    if( cache_lookup( line, &cmds, &list ) == FAILURE )
     {
-        fprintf( stderr, "No commands to process.\n" );
-        return FAILURE;
+        // keep the raw line for the cache, the lexer writes into line
+        if( ( raw = arena_strdup( &line_arena, line ) ) == NULL )
+            return FAILURE;
+
+        // an unclosed quote or substitution is a syntax error
+        if( parse_line_in_place( line, &cmds ) == FAILURE )
+        {
+            last_status = 2;
+            return FAILURE;
+        }
+
+        // nothing entered
+        if( cmds.count == 0 )
+            return SUCCESS;
+
+        // handle all alias processing 
+        if( check_for_alias() == FAILURE )
+            return FAILURE;
+
+        // split the words into pipelines, commands and redirects
+        if( parse_commands( &cmds, &list ) == FAILURE )
+        {
+            last_status = 2;
+            return FAILURE;
+        }
+
+        cache_store( raw, &cmds, &list );
     }
 
-    // handle printing of history
-    if( handle_history() == SUCCESS )
-        return SUCCESS; 
+    for( i = 0; i < list.n_pipelines; i++ )
+    {
+        pl = &list.pipelines[i];
 
-    // handle all alias processing 
-    if( handle_aliases() == FAILURE )
-        return FAILURE;
+        // check how the previous pipeline wants this one run
+        if( i > 0 && ( ( list.pipelines[i - 1].connector == TOKEN_AND && last_status != 0 ) ||
+                       ( list.pipelines[i - 1].connector == TOKEN_OR && last_status == 0 ) ) )
+            continue;
 
-    // handle environmental variable translations
-    if( handle_env_vars() == FAILURE )
-        return FAILURE;
+        // expand variables and remove quotes right before running,
+        // so "cd dir && echo $PWD" sees the new directory
+        if( expand_pipeline( &list, pl ) == FAILURE )
+        {
+            last_status = 1;
+            continue;
+        }
 
-    // handle directory changes
-    if( handle_directory_change() == SUCCESS )
-        return SUCCESS;
-        
-    // handle program execution
-    return handle_program_execution();
+        // handle program execution
+        last_status = execute( &list, pl );
+    }
+
+    return ( last_status == 0 ? SUCCESS : FAILURE );
 }/* end process_commands */
 
 
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: run_builtin                                   */
+/*      Return type:   int - exit status, 0 on success               */
+/*      Parameter(s):                                                */
+/*          builtin_id id: builtin found by the parser               */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments, argv[0] is the builtin name      */
+/*          FILE* out: where the builtin prints, stdout unless the   */
+/*                     output of $(...) is being captured            */
+/*                                                                   */
+/*      Description:                                                 */
+/*          Routes a builtin to the function that handles it. Called */
+/*          by execute() in the shell itself, or in a child process  */
+/*          when the builtin is part of a pipeline, and for $(...)   */
+/*          of a builtin that only prints.                           */
+/*                                                                   */
+/*********************************************************************/
+int run_builtin( builtin_id id, int argc, char** argv, FILE* out )
+{
+    int result = FAILURE;
+
+    switch( id )
+    {
+        case BUILTIN_HISTORY:
+            result = handle_history( argc, argv, out );
+            break;
+        case BUILTIN_ALIAS:
+            result = handle_aliases( argc, argv, out );
+            break;
+        case BUILTIN_UNALIAS:
+            result = handle_unalias( argc, argv, out );
+            break;
+        case BUILTIN_CD:
+            result = handle_directory_change( argc, argv, out );
+            break;
+        case BUILTIN_CACHE:
+            print_cache_stats( out );
+            result = SUCCESS;
+            break;
+        case BUILTIN_EXPORT:
+            result = handle_export( argc, argv, out );
+            break;
+        case BUILTIN_UNSET:
+            result = handle_unset( argc, argv, out );
+            break;
+        case BUILTIN_ECHO:
+            result = handle_echo( argc, argv, out );
+            break;
+        case BUILTIN_PWD:
+            result = handle_pwd( argc, argv, out );
+            break;
+        case BUILTIN_SET:
+            result = handle_set( argc, argv, out );
+            break;
+        case BUILTIN_HASH:
+            result = handle_hash( argc, argv, out );
+            break;
+        default:
+            break;
+    }
+
+    return ( result == SUCCESS ? 0 : 1 );
+} /* end run_builtin() */
+
+
 /*********************************************************************/
 /*                                                                   */
 /*      Function name: handle_history                                */
 /*      Return type:   int                                           */
-/*      Parameter(s):  none                                          */
+/*      Parameter(s):                                                */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the history command            */
+/*          FILE* out: where the builtin prints                      */
 /*                                                                   */
 /*      Description:                                                 */
-/*          prints history of commands entered.                      */
+/*          prints history of commands entered. "history N" or       */
+/*          "history -N" prints the last N, "history FIRST LAST"     */
+/*          prints commands FIRST to LAST.                           */
 /*                                                                   */
 /*********************************************************************/
-int handle_history( void )
+int handle_history( int argc, char** argv, FILE* out )
 {
-    if ( strcmp( cmds[0], "history" ) == 0 )
+    long numbers[2], count;
+    char* end;
+    int i;
+
+    if( argc == 1 )
     {
-        print_history( stdout ); 
+        print_history( out );
         return SUCCESS;
     }
-    return FAILURE;
+
+    if( argc > 3 )
+    {
+        fprintf( stderr, "Error: usage is history [N] or history FIRST LAST\n" );
+        return FAILURE;
+    }
+
+    for( i = 1; i < argc; i++ )
+    {
+        // "history -50" is the same as "history 50"
+        numbers[i - 1] = strtol( argv[i] + ( argc == 2 && argv[i][0] == '-' ), &end, 10 );
+        if( !isdigit( (unsigned char)argv[i][argc == 2 && argv[i][0] == '-'] ) || *end != '\0' )
+        {
+            fprintf( stderr, "Error: history needs a number - %s\n", argv[i] );
+            return FAILURE;
+        }
+    }
+
+    if( argc == 2 )
+    {
+        count = history_count();
+        print_history_range( out, count - numbers[0] + 1, count );
+    }
+    else
+        print_history_range( out, numbers[0], numbers[1] );
+
+    return SUCCESS;
 } /* end handle_history() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: check_for_alias                               */
+/*      Function name: handle_aliases                                */
 /*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the alias command              */
+/*          FILE* out: where the builtin prints                      */
+/*                                                                   */
 /*      Description:                                                 */
-/*          Checks for aliases and converts them if found.           */
-/*          Return failure anytime an alias isnt being translated.   */
-/*          This is done so that way we know when we dont need to    */
-/*          use the alias any further.                               */
+/*          Prints every alias, prints one alias, or adds one.       */
 /*                                                                   */
 /*********************************************************************/
-int handle_aliases( void )
+int handle_aliases( int argc, char** argv, FILE* out )
 {
-    // case found keyword "alias"
-    if ( strcmp( cmds[0], "alias" ) == 0 )
+    char* equals, * name;
+    alias* specified = NULL;
+
+    // if alias is only command
+    if( argc == 1 )
     {
-        // if alias is only command
-        if( n_cmds == 1 )
-        {
-            print_aliases();
+        print_aliases( out );
+        return SUCCESS;
+    }
+    else if( argc == 2 && ( equals = strchr( argv[1], '=' ) ) != NULL )
+    {
+        // name="value" is a single word once the quotes are removed,
+        // copy the name out since the word may belong to the cache
+        if( ( name = arena_strndup( &line_arena, argv[1], equals - argv[1] ) ) == NULL )
             return FAILURE;
-        }
-        else if( n_cmds == 2 )
+
+        if( add_alias( name, equals + 1 ) == FAILURE )
         {
-            // if we want to display a specified alias
-            alias* specified = NULL;
-
-            // search for specified alias
-            if( ( specified = find_alias( cmds[1] ) ) == NULL )
-            {
-                fprintf( stderr, "Error: could not find alias - %s\n" , cmds[1] );
-                return FAILURE;
-            }
-            
-            // show specified alias
-            printf( "%s\t%s\n", specified->name, specified->value );
+            fprintf( stderr, "Error: could not add alias %s\n", name );
             return FAILURE;
         }
-        else if( n_cmds == 4 ) 
+        return SUCCESS;
+    }
+    else if( argc == 2 )
+    {
+        // search for specified alias
+        if( ( specified = find_alias( argv[1] ) ) == NULL )
         {
-            // if adding alias, parser should separate into 4 commands
-            if( add_alias( cmds[1], cmds[3] ) == FAILURE )
-                fprintf( stderr, "Error: could not add alias %s\n", cmds[3] );
-    
+            fprintf( stderr, "Error: could not find alias - %s\n" , argv[1] );
             return FAILURE;
         }
-            
-        // if it does not match above patterns, return
-        fprintf( stderr, "Error: no alias specified to add.\n" );
-        return FAILURE;
+        
+        // show specified alias
+        fprintf( out, "%s\t%s\n", specified->name, specified->value );
+        return SUCCESS;
     }
-    else if ( strcmp( cmds[0], "unalias" ) == 0 )
+    else if( argc == 4 && strcmp( argv[2], "=" ) == 0 ) 
     {
-        // make sure user provided an alias name
-        if( n_cmds < 2 )
+        // name = "value", parser separates it into 4 words
+        if( add_alias( argv[1], argv[3] ) == FAILURE )
         {
-            fprintf( stderr, "Error: no alias specified to remove.\n" );
+            fprintf( stderr, "Error: could not add alias %s\n", argv[3] );
             return FAILURE;
         }
-        remove_alias( cmds[1] );
+        return SUCCESS;
+    }
+        
+    // if it does not match above patterns, return
+    fprintf( stderr, "Error: no alias specified to add.\n" );
+    return FAILURE;
+} /* end handle_aliases() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: handle_unalias                                */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the unalias command            */
+/*          FILE* out: where the builtin prints                      */
+/*                                                                   */
+/*********************************************************************/
+int handle_unalias( int argc, char** argv, FILE* out )
+{
+    // make sure user provided an alias name
+    if( argc < 2 )
+    {
+        fprintf( stderr, "Error: no alias specified to remove.\n" );
         return FAILURE;
     }
-    else
-        check_for_alias();    
 
-    return SUCCESS; 
-} /* end handle_aliases() */
+    return remove_alias( argv[1] );
+} /* end handle_unalias() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: handle_env_vars                               */
+/*      Function name: handle_export                                 */
 /*      Return type:   int                                           */
-/*      Parameter(s):  none                                          */
+/*      Parameter(s):                                                */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the export command             */
+/*          FILE* out: where the builtin prints                      */
 /*                                                                   */
 /*      Description:                                                 */
-/*          Checks for environmental variables and calls conversion  */
-/*          function.                                                */
+/*          exports each "NAME" or "NAME=value" given, or prints     */
+/*          every exported variable when there are none.             */
 /*                                                                   */
 /*********************************************************************/
-int handle_env_vars( void )
+int handle_export( int argc, char** argv, FILE* out )
 {
-    int i;
+    int i, result = SUCCESS;
+    size_t n;
 
-    // go through cmds looking for an environmental variable
-    for( i = 0; i < n_cmds; i++ )
+    if( argc == 1 )
     {
-        // if we find an environmental variable - not in quotes
-        if( strcmp( cmds[i], "$" ) == 0 )
+        print_variables( out );
+        return SUCCESS;
+    }
+
+    for( i = 1; i < argc; i++ )
+    {
+        n = variable_name_length( argv[i] );
+
+        if( n == 0 || ( argv[i][n] != '=' && argv[i][n] != '\0' ) )
+        {
+            fprintf( stderr, "Error: export: not a valid name - %s\n", argv[i] );
+            result = FAILURE;
+        }
+        else if( argv[i][n] == '=' )
         {
-            // if conversion fails
-            if ( convert_env_var( i ) == FAILURE )
-            {
-                fprintf( stderr, "Error: could not convert environtmental variable - %s\n", cmds[i + 1] );
-                return FAILURE;
-            }
-
-            // cmds have been shifted down, so account for it
-            i--; 
-        } 
-        else // check for possible environmental variables in quoted cmd
-            check_for_var_in_quotes( i );
+            if( set_variable( argv[i], n, &argv[i][n + 1], VAR_EXPORT ) == FAILURE )
+                result = FAILURE;
+        }
+        else if( export_variable( argv[i] ) == FAILURE )
+            result = FAILURE;
     }
-    return SUCCESS; 
-} /* end handle_env_vars() */
+
+    return result;
+} /* end handle_export() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: handle_directory_change                       */
+/*      Function name: handle_unset                                  */
 /*      Return type:   int                                           */
-/*      Parameter(s):  none                                          */
-/*                                                                   */
-/*      Description:                                                 */
-/*          Determines and conducts directory change if needed.      */
+/*      Parameter(s):                                                */
+/*          int argc: number of arguments                            */
+/*          char** argv: names of the variables to remove            */
+/*          FILE* out: where the builtin prints                      */
 /*                                                                   */
 /*********************************************************************/
-int handle_directory_change( void )
+int handle_unset( int argc, char** argv, FILE* out )
 {
-    // ensure we want to switch directories
-    if ( strcmp( cmds[0], "cd" ) != 0 )
-        return FAILURE;
+    int i, result = SUCCESS;
+    size_t n;
 
-    // switching to home directory 
-    if ( n_cmds == 1 || ( n_cmds == 2 && ( strcmp( cmds[1], "~/" ) == 0 || strcmp( cmds[1], "~" ) == 0 ) ) )
-        return change_to_home_dir();
+    for( i = 1; i < argc; i++ )
+    {
+        n = variable_name_length( argv[i] );
 
-    // switching to previous directory
-    if ( n_cmds == 2 && strcmp( cmds[1], "-" ) == 0 )
-        return change_to_prev_dir();
+        if( n == 0 || argv[i][n] != '\0' )
+        {
+            fprintf( stderr, "Error: unset: not a valid name - %s\n", argv[i] );
+            result = FAILURE;
+        }
+        else
+            unset_variable( argv[i] );
+    }
 
-    // switching to any other directory 
-    return change_dir();
-} /* end handle_directory_change() */
+    return result;
+} /* end handle_unset() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: handle_program_execution                      */
+/*      Function name: handle_echo                                   */
 /*      Return type:   int                                           */
-/*      Parameter(s):  none                                          */
+/*      Parameter(s):                                                */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the echo command               */
+/*          FILE* out: where the builtin prints                      */
 /*                                                                   */
 /*      Description:                                                 */
-/*          Routes all program execution to their respected          */
-/*          functions.                                               */
+/*          prints the arguments separated by spaces, with a newline */
+/*          after them unless the first argument is -n.              */
 /*                                                                   */
 /*********************************************************************/
-int handle_program_execution( void )
+int handle_echo( int argc, char** argv, FILE* out )
 {
-    // set up input/output redirects and pipes
-    int i, j = 0, n_pipes = count_pipes(), outfile = is_redirect( 'o' ), infile = is_redirect( 'i' );
-    int pipe_index[n_pipes];
+    int i = 1, newline = T;
 
-    // store the locations of each pipe
-    // this is a bit redundant but I will improve later
-    for( i = 0; i < n_cmds; i++ )
+    if( argc > 1 && strcmp( argv[1], "-n" ) == 0 )
     {
-        if( strcmp( cmds[i], "|" ) == 0 )
-           pipe_index[j++] = i;  
+        newline = F;
+        i++;
     }
 
-    // execute command
-    execute( infile, outfile, n_pipes, pipe_index );
-   
+    for( ; i < argc; i++ )
+    {
+        fputs( argv[i], out );
+        if( i + 1 < argc )
+            fputc( ' ', out );
+    }
+
+    if( newline )
+        fputc( '\n', out );
+
     return SUCCESS;
-} /* end handle_program_execution() */
+} /* end handle_echo() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: check_for_alias                               */
-/*      Return type:   void                                          */
-/*      Parameter(s):  none                                          */
+/*      Function name: handle_pwd                                    */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the pwd command                */
+/*          FILE* out: where the builtin prints                      */
 /*                                                                   */
 /*      Description:                                                 */
-/*          checks for aliases and converts them if found            */
+/*          prints $PWD, which cd keeps up to date, or asks the      */
+/*          system when it is not set.                               */
 /*                                                                   */
 /*********************************************************************/
-int check_for_alias( void ) 
+int handle_pwd( int argc, char** argv, FILE* out )
 {
-    alias* found;
-    char* alias_cmds[MAX_CMDS];
-    int i, j, n_alias_cmds = 0;
+    fprintf( out, "%s\n", current_dir() );
+    return SUCCESS;
+} /* end handle_pwd() */
 
-    // go through commands
-    for( i = 0; i < n_cmds; i++ )
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: handle_set                                    */
+/*      Return type:   int                                           */
+/*      Parameter(s):                                                */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the set command                */
+/*          FILE* out: where the builtin prints                      */
+/*                                                                   */
+/*      Description:                                                 */
+/*          "set" prints every option, "set name=value ..." changes  */
+/*          them.                                                    */
+/*                                                                   */
+/*********************************************************************/
+int handle_set( int argc, char** argv, FILE* out )
+{
+    int i, result = SUCCESS;
+
+    if( argc == 1 )
     {
-        // check if command is an alias
-        if( ( found = find_alias( cmds[i] ) ) != NULL )
-        {
-            // parse alias value
-            if( parse_string( found->value, alias_cmds, &n_alias_cmds ) == FAILURE )
-            {
-                fprintf( stderr, "Error: could not parse alias value\n" );
-                return FAILURE;
-            }
-
-            // place alias value into cmds[]
-            if( merge_string_arrays( cmds, n_cmds, alias_cmds, n_alias_cmds, i ) == FAILURE )
-            {
-                fprintf( stderr, "Error: could not merge alias value into cmds\n" );
-                return FAILURE;
-            }
-
-            // adjust n_cmds
-            n_cmds += ( n_alias_cmds - 1 );
-
-            // clear alias_cmds and reset n_alias_cmds in case we find more aliases
-            for( j = 0; j < n_alias_cmds; j++ )
-            {
-                free( alias_cmds[j] );
-                alias_cmds[j] = NULL;
-            }
-            n_alias_cmds = 0;
-        }
+        print_options( out );
+        return SUCCESS;
+    }
+
+    for( i = 1; i < argc; i++ )
+    {
+        if( set_option( argv[i] ) == FAILURE )
+            result = FAILURE;
     }
-    return SUCCESS; 
-} /* end check_for_alias() */
+
+    return result;
+} /* end handle_set() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: check_for_var_in_quotes                       */
-/*      Return type:   void                                          */
+/*      Function name: handle_hash                                   */
+/*      Return type:   int                                           */
 /*      Parameter(s):                                                */
-/*          int i: the index of the str in cmds[] we are searching   */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the hash command               */
+/*          FILE* out: where the builtin prints                      */
 /*                                                                   */
 /*      Description:                                                 */
-/*          checks for env variables inside of a string,             */
-/*          it is used to search through quoted commands for         */
-/*          env vars                                                 */
+/*          "hash" lists the programs found in $PATH so far, "hash   */
+/*          -r" forgets them and "hash name" looks name up again.    */
 /*                                                                   */
 /*********************************************************************/
-int check_for_var_in_quotes( int i )
+int handle_hash( int argc, char** argv, FILE* out )
 {
-    char* cur_env_loc = NULL, * prev_env_loc = NULL, * translated_env_var = NULL; 
-    char env_var[WORD_LIMIT] = "", buffer[WORD_LIMIT] = "";
-    int j;
+    int i, result = SUCCESS;
 
-    // search for an env var indicator in the quoted string ($)
-    if( ( cur_env_loc = strstr( cmds[i], "$" ) ) != NULL )
+    if( argc == 1 )
     {
-        // copy everything up to env var into buffer
-        strncpy( buffer, cmds[i], cur_env_loc - cmds[i] );
+        print_programs( out );
+        return SUCCESS;
+    }
 
-        // gather, convert, and append env var
-        do 
-        {
-            // env variables don't start with digits
-            if( isdigit( *(cur_env_loc++) ) )
-            {
-                prev_env_loc = cur_env_loc;
-                continue; 
-            }
-
-            // copy characters in between env vars if found multiple
-            if( cur_env_loc != prev_env_loc && prev_env_loc != NULL )
-                strncat( buffer, prev_env_loc, (int)(cur_env_loc - prev_env_loc - 1) );
-
-            // clear out env_var[]
-            memset( env_var, 0, WORD_LIMIT * sizeof( char ) );
-
-            // get the var name
-            for( j = 0; !isspace( *cur_env_loc ) && !ispunct( *cur_env_loc ) && !isdigit( *cur_env_loc ) && *cur_env_loc != '\0' && *cur_env_loc != '$'; j++ )
-                env_var[j] = *(cur_env_loc++); 
-
-            // translate env var & append to buffer
-            if( ( translated_env_var = getenv( env_var ) ) == NULL )
-            {
-                fprintf( stderr, "Error: could not find env var $%s\n", env_var );
-                return FAILURE;
-            }
-            else if( strlen( buffer ) + strlen( translated_env_var ) < WORD_LIMIT )
-                strcat( buffer, translated_env_var );
-            else
-            {
-                fprintf( stderr, "Error: command too large after appending environmental variable $%s\n", env_var );
-                fprintf( stderr, "       command before attempt to append: %s\n", buffer );
-                return FAILURE;
-            }
-
-            // store end location of var name
-            prev_env_loc = cur_env_loc;
-        }
-        while( ( cur_env_loc = strstr( prev_env_loc, "$" ) ) != NULL );
+    if( strcmp( argv[1], "-r" ) == 0 && argc == 2 )
+    {
+        clear_programs();
+        return SUCCESS;
+    }
 
-        // copy the remainder of cmds[i] into buffer
-        if( strlen( buffer ) + strlen( &cmds[i][prev_env_loc - cmds[i]] ) < WORD_LIMIT )
-            strcat( buffer, &cmds[i][prev_env_loc - cmds[i]] );
-        else
+    for( i = 1; i < argc; i++ )
+    {
+        if( argv[i][0] == '-' )
         {
-            fprintf( stderr, "Error: command too large after appending last part (%s)\n", &cmds[i][prev_env_loc - cmds[i]] );
+            fprintf( stderr, "Error: hash only takes -r - %s\n", argv[i] );
             return FAILURE;
         }
-
-        // replace cmds[i] with buffer
-        free( cmds[i] );
-        add_string( buffer, cmds, i );
+        if( remember_program( argv[i] ) == FAILURE )
+            result = FAILURE;
     }
 
-    return SUCCESS; 
-} /* end check_for_var_in_quotes() */
+    return result;
+} /* end handle_hash() */
 
 
 /*********************************************************************/
 /*                                                                   */
-/*      Function name: convert_env_var                               */
+/*      Function name: handle_directory_change                       */
 /*      Return type:   int                                           */
 /*      Parameter(s):                                                */
-/*          int index: the index in cmds that we found the env_var   */
-/*                     indicator ($)                                 */
+/*          int argc: number of arguments                            */
+/*          char** argv: arguments of the cd command                 */
+/*          FILE* out: where the builtin prints                      */
 /*                                                                   */
 /*      Description:                                                 */
-/*          checks for environmental variables and converts cmds[]   */
-/*          so that it has variable value (must not be in quotes)    */
+/*          Determines and conducts directory change.                */
 /*                                                                   */
 /*********************************************************************/
-int convert_env_var( int index )
+int handle_directory_change( int argc, char** argv, FILE* out )
 {
-    // get variable value
-    char* env_var = getenv( cmds[index + 1] );
-    
-    // case env var not found, exit gracefully
-    if( env_var == NULL )
+    // switching to home directory 
+    if ( argc == 1 || ( argc == 2 && ( strcmp( argv[1], "~/" ) == 0 || strcmp( argv[1], "~" ) == 0 ) ) )
+        return change_to_home_dir( out );
+
+    // switching to previous directory
+    if ( argc == 2 && strcmp( argv[1], "-" ) == 0 )
+        return change_to_prev_dir( out );
+
+    if( argc != 2 )
     {
-        fprintf( stderr, "Error: could not translate environmental variable - %s\n", cmds[index + 1] );
-        return FAILURE; 
+        fprintf( stderr, "Error: directory not provided\n" );
+        return FAILURE;
     }
 
-    // remove variable name
-    free( cmds[index + 1] );
+    // switching to any other directory 
+    return change_dir( argv[1], out );
+} /* end handle_directory_change() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: check_for_alias                               */
+/*      Return type:   int                                           */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          checks the program name of every command for an alias    */
+/*          and converts it if found. Once an alias is found the     */
+/*          line is rebuilt in alias_cmds, in one pass, and swapped  */
+/*          with cmds. Words of an alias value are not checked       */
+/*          again, so an alias may use its own name.                 */
+/*                                                                   */
+/*********************************************************************/
+int check_for_alias( void ) 
+{
+    alias* found;
+    word_vector value, swap;
+    int i, copied = 0, command_start = T;
+
+    alias_cmds.count = 0;
 
-    // replace with variable value
-    if( add_string( env_var, cmds, index + 1 ) == FAILURE )
+    // go through commands
+    for( i = 0; i < cmds.count; i++ )
     {
-        fprintf( stderr, "Error: could not place environmental variable in cmds - %s\n", env_var );
-        return FAILURE;
+        if( cmds.kinds[i] != TOKEN_WORD )
+        {
+            // a new command starts after | || && ;
+            // and a file name follows < > >>
+            if( cmds.kinds[i] < TOKEN_REDIRECT_IN )
+                command_start = T;
+            else if( cmds.kinds[i] <= TOKEN_APPEND )
+                i++;
+            continue;
+        }
+
+        // only the program name can be an alias, and it comes
+        // after any "NAME=value" words
+        if( !command_start || is_assignment( cmds.words[i] ) )
+            continue;
+        command_start = F;
+
+        // check if command is an alias
+        if( ( found = find_alias( cmds.words[i] ) ) == NULL )
+            continue;
+
+        // the value was split into words when the alias was added
+        value.words = found->words;
+        value.kinds = found->kinds;
+        value.count = value.capacity = found->n_words;
+
+        // copy the words since the last alias, then the alias value
+        if( append_strings( &alias_cmds, &cmds, copied, i - copied ) == FAILURE ||
+            append_strings( &alias_cmds, &value, 0, value.count ) == FAILURE )
+        {
+            fprintf( stderr, "Error: could not merge alias value into cmds\n" );
+            return FAILURE;
+        }
+        copied = i + 1;
     }
-    
-    // shift all cmds down by one, starting at index + 1
-    if( shift_strings_down( cmds, &n_cmds, index + 1, 1 ) == FAILURE )
+
+    // no alias found, cmds is already right
+    if( copied == 0 )
+        return SUCCESS;
+
+    // copy the rest of the words
+    if( append_strings( &alias_cmds, &cmds, copied, cmds.count - copied ) == FAILURE )
     {
-        fprintf( stderr, "Error: convert_env_var() - could not shift cmds to remove '$'\n" );
+        fprintf( stderr, "Error: could not merge alias value into cmds\n" );
         return FAILURE;
     }
-    return SUCCESS;
-} /* end convert_env_var() */
+
+    // the rebuilt line becomes cmds
+    swap = cmds;
+    cmds = alias_cmds;
+    alias_cmds = swap;
+
+    return SUCCESS; 
+} /* end check_for_alias() */
 
 
 /*********************************************************************/
 /*                                                                   */
 /*      Function name: change_to_home_dir                            */
 /*      Return type:   int                                           */
-/*      Parameter(s):  none                                          */
+/*      Parameter(s):                                                */
+/*          FILE* out: where the new directory is printed            */
 /*                                                                   */
 /*      Description:                                                 */
 /*          Attempts to change directories to the user's $HOME dir   */
 /*                                                                   */
 /*********************************************************************/
-int change_to_home_dir( void )
+int change_to_home_dir( FILE* out )
 {
+    const char* home = get_variable( "HOME" );
+    char old_dir[PATH_MAX];
+
     // check that $HOME has a valid directory value
-    if( is_directory( getenv( "HOME" ) ) )
+    if( home != NULL && is_directory( home ) )
     {
+        // without $PWD, where we were is only known before chdir()
+        snprintf( old_dir, PATH_MAX, "%s", current_dir() );
+
         // change to $HOME directory
-        if( chdir( getenv( "HOME" ) ) != 0 )
+        if( chdir( home ) != 0 )
         {
             printf("Error: Cannot switch to home directory.\n" );
             return FAILURE;
@@ -602,13 +865,13 @@ int change_to_home_dir( void )
         else
         {
             // set previous_dir
-            strcpy( previous_dir, getenv( PWD ) );
+            strcpy( previous_dir, old_dir );
 
             // set $PWD 
-            setenv( PWD, getenv( "HOME" ), 1 );
+            set_variable( PWD, strlen( PWD ), home, VAR_KEEP );
 
             // display new directory
-            puts( getenv( PWD ) );
+            fprintf( out, "%s\n", current_dir() );
         }
     }
     return SUCCESS;
@@ -619,14 +882,20 @@ int change_to_home_dir( void )
 /*                                                                   */
 /*      Function name: change_to_prev_dir                            */
 /*      Return type:   int                                           */
-/*      Parameter(s):  none                                          */
+/*      Parameter(s):                                                */
+/*          FILE* out: where the new directory is printed            */
 /*                                                                   */
 /*      Description:                                                 */
 /*          Attempts to change directories to the previous dir       */
 /*                                                                   */
 /*********************************************************************/
-int change_to_prev_dir( void )
+int change_to_prev_dir( FILE* out )
 {
+    // set temporary holding spot for previous_dir, without $PWD
+    // where we were is only known before chdir()
+    char temp_prev_dir[PATH_MAX];
+    snprintf( temp_prev_dir, PATH_MAX, "%s", current_dir() );
+
     // change to previous dir
     if ( chdir( previous_dir ) != 0 )
     {
@@ -634,18 +903,14 @@ int change_to_prev_dir( void )
         return FAILURE;   
     }
 
-    // set temporary holding spot for previous_dir
-    char temp_prev_dir[WORD_LIMIT];
-    strcpy( temp_prev_dir, getenv( PWD ) );
-
     // change $PWD 
-    setenv( PWD, previous_dir, 1 );
+    set_variable( PWD, strlen( PWD ), previous_dir, VAR_KEEP );
 
     // set previous_dir
     strcpy( previous_dir, temp_prev_dir );
 
     // display new directory
-    puts( getenv( PWD ) );
+    fprintf( out, "%s\n", current_dir() );
 
     return SUCCESS;    
 } /* end change_to_prev_dir() */
@@ -655,61 +920,70 @@ int change_to_prev_dir( void )
 /*                                                                   */
 /*      Function name: change_dir                                    */
 /*      Return type:   int                                           */
-/*      Parameter(s):  none                                          */
+/*      Parameter(s):                                                */
+/*          const char* dir: directory the user provided             */
+/*          FILE* out: where the new directory is printed            */
 /*                                                                   */
 /*      Description:                                                 */
 /*          Attempts to change directories to user specified dir     */
 /*                                                                   */
 /*********************************************************************/
-int change_dir( void )
+int change_dir( const char* dir, FILE* out )
 {
-    char* found = NULL, abs_path[WORD_LIMIT];
+    char* found = NULL, path[PATH_MAX], abs_path[PATH_MAX], old_dir[PATH_MAX];
+    size_t len = strlen( dir );
 
-    if( n_cmds == 2 )
-    {   
-        // remove last '/' in cmds[1]
-        if( cmds[1][strlen( cmds[1] ) - 1] == '/' )
-            cmds[1][strlen( cmds[1] ) - 1] = '\0';
+    if( len == 0 || len >= PATH_MAX )
+    {
+        fprintf( stderr, "Error: Cannot change directory to %s\n", dir );
+        return FAILURE;
+    }
+    strcpy( path, dir );
 
-        // translate dir path if user provider ".." in cmd
-        while( ( found = strstr( cmds[1], ".." ) ) != NULL )
-        {
-            if( translate_dir_path( (int)( found - cmds[1] ) ) == FAILURE )
-            {
-                fprintf( stderr, "Error: could not translate directory path provided.\n" );
-                return FAILURE;
-            }
-        }
-    
-        // if we are changing to relative dir, make it an absolute from $PWD
-        if( cmds[1][0] != '/' )
+    // remove last '/' in path, unless path is "/"
+    if( len > 1 && path[len - 1] == '/' )
+        path[len - 1] = '\0';
+
+    // translate dir path if user provider ".." in cmd
+    while( ( found = strstr( path, ".." ) ) != NULL )
+    {
+        if( translate_dir_path( path, (int)( found - path ) ) == FAILURE )
         {
-            sprintf( abs_path, "%s/%s", getenv( PWD ), cmds[1] );
-            free( cmds[1] );
-            add_string( abs_path, cmds, 1 );
+            fprintf( stderr, "Error: could not translate directory path provided.\n" );
+            return FAILURE;
         }
+    }
 
-        // switch to directory user provided
-        if ( chdir( cmds[1] ) != 0 )
+    // if we are changing to relative dir, make it an absolute from $PWD
+    if( path[0] != '/' )
+    {
+        if( snprintf( abs_path, PATH_MAX, "%s/%s", current_dir(), path ) >= PATH_MAX )
         {
-            fprintf( stderr, "Error: Cannot change directory to %s\n", cmds[1] );
+            fprintf( stderr, "Error: Cannot change directory to %s\n", path );
             return FAILURE;
-        } 
-        
-        // set previous_dir
-        strcpy( previous_dir, getenv( PWD ) );
-
-        // change $PWD
-        setenv( PWD, cmds[1], 1 );
-    
-        // display new directory
-        puts( getenv( PWD ) );
+        }
+        strcpy( path, abs_path );
     }
-    else
+
+    // without $PWD, where we were is only known before chdir()
+    snprintf( old_dir, PATH_MAX, "%s", current_dir() );
+
+    // switch to directory user provided
+    if ( chdir( path ) != 0 )
     {
-        fprintf( stderr, "Error: directory not provided\n" );
+        fprintf( stderr, "Error: Cannot change directory to %s\n", path );
         return FAILURE;
-    }
+    } 
+    
+    // set previous_dir
+    strcpy( previous_dir, old_dir );
+
+    // change $PWD
+    set_variable( PWD, strlen( PWD ), path, VAR_KEEP );
+
+    // display new directory
+    fprintf( out, "%s\n", current_dir() );
+
     return SUCCESS;
 } /* end change_dir() */
 
@@ -719,24 +993,24 @@ int change_dir( void )
 /*      Function name: translate_dir_path                            */
 /*      Return type:   int                                           */
 /*      Parameter(s):                                                */
-/*          int loc: location of first occurence of ".." in user     */
-/*                   provided path                                   */
+/*          char* path: user provided path, PATH_MAX bytes           */
+/*          int loc: location of first occurence of ".." in path     */
 /*                                                                   */
 /*      Description:                                                 */
-/*          modifies the user provided directory path in cmds[1]     */
-/*          in the case that the user wishes to cd using ".."        */
+/*          modifies the user provided directory path in the case    */
+/*          that the user wishes to cd using ".."                    */
 /*                                                                   */
 /*********************************************************************/
-int translate_dir_path( int loc )
+int translate_dir_path( char* path, int loc )
 {
-    char new_path[WORD_LIMIT] = "", buffer[WORD_LIMIT] = "";
+    char new_path[PATH_MAX] = "", buffer[PATH_MAX] = "";
     char* last_dir_loc = NULL;
 
     // case the user provided path starts with ".."
     if( loc == 0 )
-        strcpy( buffer, getenv( PWD ) );
+        snprintf( buffer, PATH_MAX, "%s", current_dir() );
     else // case the ".." is later in the path
-        strncpy( buffer, cmds[1], loc - 1 );
+        strncpy( buffer, path, loc - 1 );
 
     // check if we are already in root directory
     if( strcmp( buffer, "/" ) == 0 )
@@ -750,12 +1024,11 @@ int translate_dir_path( int loc )
         strncpy( new_path, buffer, (size_t)( last_dir_loc - buffer == 0 ? 1 : last_dir_loc - buffer ) );
 
     // append the rest of the user provided path if theres more
-    if( strlen( cmds[1] ) - 1 > loc + 2 )
-        strcat( new_path, &cmds[1][loc + 2] );
+    if( strlen( path ) - 1 > loc + 2 )
+        strcat( new_path, &path[loc + 2] );
 
-    // reset user provided cmd
-    free( cmds[1] );
-    add_string( new_path, cmds, 1 );
+    // reset user provided path
+    strcpy( path, new_path );
 
     return SUCCESS;
 }
@@ -767,42 +1040,6 @@ int translate_dir_path( int loc )
 /*********************************************************************/
 
 
-/*********************************************************************/
-/*                                                                   */
-/*      Function name: is_redirect                                   */
-/*      Return type:   char* - name of file being redirected to      */
-/*      Parameter(s):                                                */
-/*          const char type: type of redirection ('i' for input,     */
-/*                           'o' for output)                         */
-/*                                                                   */
-/*      Description:                                                 */
-/*          returns the name of the file we are redirecting input    */
-/*          or output to.                                            */
-/*                                                                   */
-/*********************************************************************/
-int is_redirect( const char type )
-{
-    if( type != 'i' && type != 'o' )
-    {
-        fprintf( stderr, "Error: incorrect type specified in is_redirect()\n" );
-        fprintf( stderr, "       valid types are 'i' or 'o'\n" );
-        return -1;
-    }
-
-    char* io = ( type == 'i' ? "<" : ">" );
-    int i = 0;
-
-    for ( ; i < n_cmds - 1; i++ )
-    {
-        if ( strcmp( cmds[i], io ) == 0 )
-            return i + 1;
-    }
-
-    return -1; 
-} /* end is_redirect() */
-
-
-
 /*********************************************************************/
 /*                                                                   */
 /*      Function name: print_commands                                */
@@ -817,8 +1054,8 @@ int is_redirect( const char type )
 void print_commands( void )
 {
     puts(" ");
-    for ( int i = 0; i <= n_cmds; i++ )
-        printf( "command %d: %s\n", i, cmds[i] );
+    for ( int i = 0; i <= cmds.count; i++ )
+        printf( "command %d: %s\n", i, cmds.words[i] );
 
     return;
 } /* end print_commands() */
@@ -845,6 +1082,31 @@ int is_directory( const char* dirname )
 } /* end is_directory() */
 
 
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: current_dir                                   */
+/*      Return type:   const char*                                   */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*      Description:                                                 */
+/*          returns $PWD, or asks the system when it was unset. If   */
+/*          even that fails, e.g. the directory was removed, "." is  */
+/*          returned so paths built from it stay relative to where   */
+/*          we are. Good until the next call.                        */
+/*                                                                   */
+/*********************************************************************/
+const char* current_dir( void )
+{
+    static char cwd[PATH_MAX];
+    const char* pwd = get_variable( PWD );
+
+    if( pwd == NULL && ( pwd = getcwd( cwd, PATH_MAX ) ) == NULL )
+        pwd = ".";
+
+    return pwd;
+} /* end current_dir() */
+
+
 /*********************************************************************/
 /*                                                                   */
 /*      Function name: file_exists                                   */
@@ -865,24 +1127,3 @@ int is_reg_file( const char* filename )
     return S_ISREG( buffer.st_mode );
 } /* end is_reg_file() */
 
-
-/*********************************************************************/
-/*                                                                   */
-/*      Function name: count_pipes                                   */
-/*      Return type:   void                                          */
-/*      Parameter(s):  None                                          */
-/*                                                                   */
-/*      Description:                                                 */
-/*          counts the number of pipes in the current command        */
-/*                                                                   */
-/*********************************************************************/
-int count_pipes( void )
-{
-    int i, n_pipes = 0;
-    for( i = 0; i < n_cmds; i++ )
-    {
-        if( strcmp( cmds[i], "|" ) == 0 )
-            n_pipes += 1;
-    }
-    return n_pipes; 
-} /* end count_pipes() */
@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# pipesize_bench.sh - measures how fast a pipeline moves data for each
+# pipe size. Every size runs "head -c BYTES /dev/zero | cat | cat | wc -c"
+# through the shell a few times and keeps the best time.
+#
+#   sh pipesize_bench.sh ../ubin/shell [MB] [RUNS]
+
+shell=${1:-../ubin/shell}
+megabytes=${2:-2048}
+runs=${3:-3}
+home=$(mktemp -d) || exit 1
+bytes=$((megabytes * 1048576))
+
+# now_ms: milliseconds since the epoch
+now_ms()
+{
+    echo $(($(date +%s%N) / 1000000))
+}
+
+echo "pipesize  best of $runs  MB/s    ($megabytes MB, max $(cat /proc/sys/fs/pipe-max-size) bytes)"
+
+for size in 4k 16k 0 256k 1M; do
+    best=
+    run=0
+    while [ $run -lt "$runs" ]; do
+        start=$(now_ms)
+        printf 'pipesize=%s head -c %s /dev/zero | cat | cat | wc -c\nexit\n' "$size" "$bytes" |
+            env -i HOME="$home" PATH=/usr/bin:/bin USER=tester "$shell" > /dev/null 2>&1
+        elapsed=$(($(now_ms) - start))
+        if [ -z "$best" ] || [ $elapsed -lt "$best" ]; then
+            best=$elapsed
+        fi
+        run=$((run + 1))
+    done
+    [ "$best" -eq 0 ] && best=1
+    printf '%-9s %6d ms   %6d\n' "$size" "$best" $((megabytes * 1000 / best))
+done
+
+rm -rf "$home"
@@ -0,0 +1,231 @@
+/*********************************************************************/
+/*                                                                   */
+/*          Program name: scan_test.c                                */
+/*          Description:                                             */
+/*              Runs the same lines through every scan kernel the    */
+/*              CPU supports and checks they find the same word      */
+/*              boundaries and give the same tokens as the scalar    */
+/*              kernel. The lines are edge cases around the block    */
+/*              widths and random mixes of word bytes and boundary   */
+/*              bytes. Prints each difference and exits with 1 if    */
+/*              there is one.                                        */
+/*                                                                   */
+/*********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../lib/string_module.h"
+#include "../lib/scan_module.h"
+
+/* macros */
+#define TEST_LINE_SIZE 256          /* longest line tested              */
+#define TEST_RANDOM_LINES 5000      /* random lines per kernel          */
+#define TEST_SEED 12345
+
+/* bytes random lines are made of, boundaries are picked more often */
+static const char word_bytes[] = "abcXYZ019_-./:,@%+=~\x80\xff";
+static const char boundary_bytes[] = " \t\n'\"\\|&;<>$`(){}";
+
+/* static function prototypes */
+static int     compare_line( const char* kernel, const char* line );
+static int     supported( const char* kernel );
+static void    make_edge_line( char* line, int length, int boundary, char c );
+static void    make_random_line( char* line, unsigned int* seed );
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: main                                          */
+/*      Return type:   int - 0 when every kernel agrees, 1 otherwise */
+/*      Parameter(s):  none                                          */
+/*                                                                   */
+/*********************************************************************/
+int main( void )
+{
+    static const char* const kernels[] = { "sse2", "avx2" };
+    char line[TEST_LINE_SIZE + 1];
+    unsigned int seed;
+    int k, i, length, boundary, failures = 0, lines;
+    size_t c;
+
+    // lines with an unclosed substitution are expected, not reported
+    freopen( "/dev/null", "w", stderr );
+
+    scan_init();
+    printf( "scan_test: the shell would use %s\n", scan_kernel_name() );
+
+    for( k = 0; k < (int)( sizeof(kernels) / sizeof(kernels[0]) ); k++ )
+    {
+        if( !supported( kernels[k] ) )
+        {
+            printf( "scan_test: %s not supported, skipped\n", kernels[k] );
+            continue;
+        }
+        lines = 0;
+
+        // one boundary byte at every position of lines around the block widths
+        for( length = 1; length <= 70; length++ )
+        {
+            for( boundary = -1; boundary < length; boundary++ )
+            {
+                for( c = 0; c < strlen( boundary_bytes ); c++, lines++ )
+                {
+                    make_edge_line( line, length, boundary, boundary_bytes[c] );
+                    failures += compare_line( kernels[k], line );
+                }
+            }
+        }
+
+        for( i = 0, seed = TEST_SEED; i < TEST_RANDOM_LINES; i++, lines++ )
+        {
+            make_random_line( line, &seed );
+            failures += compare_line( kernels[k], line );
+        }
+
+        printf( "scan_test: %s, %d lines compared with scalar\n", kernels[k], lines );
+    }
+
+    if( failures != 0 )
+    {
+        printf( "scan_test: %d lines differ\n", failures );
+        return 1;
+    }
+
+    printf( "scan_test: passed\n" );
+    return 0;
+} /* end main() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*                    HELPER FUNCTIONS (LOW LEVEL)                   */
+/*                                                                   */
+/*********************************************************************/
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: compare_line                                  */
+/*      Return type:   int - 0 if kernel agrees with scalar, else 1  */
+/*      Parameter(s):                                                */
+/*          const char* kernel: kernel checked                       */
+/*          const char* line: line to scan                           */
+/*                                                                   */
+/*      Description:                                                 */
+/*          compares scan_to_boundary() from every position, then    */
+/*          the tokens of the whole line, between scalar and kernel. */
+/*                                                                   */
+/*********************************************************************/
+static int compare_line( const char* kernel, const char* line )
+{
+    char copy[TEST_LINE_SIZE + 1];
+    token_vector expected = { NULL, 0, 0 }, found = { NULL, 0, 0 };
+    int pos, len = (int)strlen( line ), want, got, result = 0, ok_expected, ok_found;
+
+    for( pos = 0; pos <= len; pos++ )
+    {
+        scan_select( "scalar" );
+        want = scan_to_boundary( line, pos, len );
+        scan_select( kernel );
+        got = scan_to_boundary( line, pos, len );
+
+        if( want != got )
+        {
+            printf( "%s: boundary from %d is %d, scalar says %d - \"%s\"\n", kernel, pos, got, want, line );
+            result = 1;
+            break;
+        }
+    }
+
+    // the tokenizer calls scan_to_boundary() with the kernel selected
+    strcpy( copy, line );
+    scan_select( "scalar" );
+    ok_expected = tokenize_line( copy, &expected );
+    scan_select( kernel );
+    ok_found = tokenize_line( copy, &found );
+
+    if( ok_expected != ok_found || expected.count != found.count ||
+        ( expected.count > 0 && memcmp( expected.tokens, found.tokens, expected.count * sizeof(token) ) != 0 ) )
+    {
+        printf( "%s: %d tokens, scalar gives %d - \"%s\"\n", kernel, found.count, expected.count, line );
+        result = 1;
+    }
+
+    free( expected.tokens );
+    free( found.tokens );
+    return result;
+} /* end compare_line() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: supported                                     */
+/*      Return type:   int (T/F)                                     */
+/*      Parameter(s):                                                */
+/*          const char* kernel: "sse2" or "avx2"                     */
+/*                                                                   */
+/*      Description:                                                 */
+/*          T when the kernel was built and this CPU can run it.     */
+/*                                                                   */
+/*********************************************************************/
+static int supported( const char* kernel )
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if( strcmp( kernel, "avx2" ) == 0 )
+        return __builtin_cpu_supports( "avx2" );
+    if( strcmp( kernel, "sse2" ) == 0 )
+        return __builtin_cpu_supports( "sse2" );
+#endif
+    return F;
+} /* end supported() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: make_edge_line                                */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          char* line: set to the line made                         */
+/*          int length: bytes in the line                            */
+/*          int boundary: where c goes, -1 for nowhere               */
+/*          char c: boundary byte                                    */
+/*                                                                   */
+/*********************************************************************/
+static void make_edge_line( char* line, int length, int boundary, char c )
+{
+    memset( line, 'w', length );
+    if( boundary >= 0 )
+        line[boundary] = c;
+    line[length] = '\0';
+} /* end make_edge_line() */
+
+
+/*********************************************************************/
+/*                                                                   */
+/*      Function name: make_random_line                              */
+/*      Return type:   void                                          */
+/*      Parameter(s):                                                */
+/*          char* line: set to the line made                         */
+/*          unsigned int* seed: state of rand_r()                    */
+/*                                                                   */
+/*      Description:                                                 */
+/*          a line of random length, about one byte in eight a       */
+/*          boundary. Quotes and substitutions need not be closed,   */
+/*          both kernels must then fail the same way.                */
+/*                                                                   */
+/*********************************************************************/
+static void make_random_line( char* line, unsigned int* seed )
+{
+    int i, length = rand_r( seed ) % TEST_LINE_SIZE;
+
+    for( i = 0; i < length; i++ )
+    {
+        if( rand_r( seed ) % 8 == 0 )
+            line[i] = boundary_bytes[rand_r( seed ) % ( sizeof(boundary_bytes) - 1 )];
+        else
+            line[i] = word_bytes[rand_r( seed ) % ( sizeof(word_bytes) - 1 )];
+    }
+    line[length] = '\0';
+} /* end make_random_line() */
@@ -0,0 +1,365 @@
+#!/bin/sh
+#
+# shell_test.sh - runs command lines through the shell and checks what
+# it prints. The shell to test is the first argument, "make test" passes
+# one built with the address and undefined behaviour sanitizers, so a
+# case that reads bad memory fails even when its output looks right.
+#
+#   sh shell_test.sh ../ubin/shell_test
+
+shell=${1:-../ubin/shell}
+home=$(mktemp -d) || exit 1
+esc=$(printf '\033')
+tab=$(printf '\t')
+failures=0
+cases=0
+
+ASAN_OPTIONS=detect_leaks=0
+export ASAN_OPTIONS
+
+# run LINES: feeds LINES to the shell, prints its output without prompts,
+# with at most $fd_limit descriptors open when it is set
+run()
+{
+    [ -n "$fd_limit" ] && ulimit -n "$fd_limit"
+    printf '%s\nexit\n' "$1" |
+        env -i HOME="$home" PATH=/usr/bin:/bin USER=tester PWD="$(pwd)" ASAN_OPTIONS="$ASAN_OPTIONS" \
+            "$shell" 2>&1 |
+        sed "s/$esc\[[0-9;]*m//g" | grep -v '^tester@'
+}
+
+# check NAME LINES EXPECTED: fails NAME when LINES does not print EXPECTED
+check()
+{
+    cases=$((cases + 1))
+    got=$( (run "$2") )
+
+    if [ "$got" = "$3" ]; then
+        echo "ok      $1"
+    else
+        echo "FAILED  $1"
+        echo "--- expected"
+        echo "$3"
+        echo "--- got"
+        echo "$got"
+        failures=$((failures + 1))
+    fi
+}
+
+# empty words expand to empty strings
+check "empty quotes" 'echo ""
+echo '"''"'
+echo a"" ""b' '
+
+a b'
+check "empty variable" 'x=
+echo "$x" "${x}" "${x:-}" "${x#a}" "${#x}"' '    0'
+
+# cd and pwd work without $PWD
+check "cd after unset PWD" 'unset PWD
+cd /tmp
+pwd
+unset PWD
+cd ..
+cd -
+unset PWD
+pwd' '/tmp
+/tmp
+/
+/tmp
+/tmp'
+check "cd after unset HOME" 'unset HOME
+cd
+echo $?' '0'
+
+# a program that exists but cannot be run is not reported as not found
+printf 'echo x\n' > "$home/noexec"
+check "program not executable" "$home/noexec
+set spawn=fork
+$home/noexec" "Error: cannot run the program '$home/noexec' - Permission denied
+Error: cannot run the program '$home/noexec' - Permission denied"
+
+# every pipe end is closed in the shell once it is handed off, so a long
+# pipeline runs with a handful of descriptors and no stage sees a pipe
+# it was not given
+stages=$(i=0; while [ $i -lt 100 ]; do printf ' | cat'; i=$((i + 1)); done)
+fd_limit=16
+check "200 stages under ulimit -n 16" "seq 1 100000$stages$stages | wc -l" "100000"
+fd_limit=
+check "no pipe leaks into a stage" "true$stages | ls /proc/self/fd$stages" "0
+1
+2
+3"
+
+# pipe sizes need digits, and pipesize= in front of a pipeline is not a variable
+check "pipesize without digits" 'set pipesize=k
+pipesize=M echo | cat
+echo $?' 'Error: pipesize must be a number from 0 to 2147483647 - k
+Error: pipesize must be a number from 0 to 2147483647 - M
+1'
+check "pipesize= is not an assignment" 'pipesize=8k env | grep -c pipesize
+pipesize=8k
+echo "[$pipesize]"' '0
+[]'
+
+# a quote left open is a syntax error, the command does not run
+check "unclosed quotes" "echo 'abc
+echo \$?
+echo \"a\\\"
+echo \"x\\\"y\" 'it''s'" "Error: syntax error, single quote is not closed
+2
+Error: syntax error, double quote is not closed
+x\"y its"
+
+# redirect descriptors are range checked when the line is parsed
+check "redirect descriptor range" 'echo a 99999999999>&1
+echo b >&99999999999
+echo $?
+echo c 1024>/dev/null
+/bin/echo d 2>&1 1023>/dev/null' "Error: syntax error, descriptor out of range in '99999999999>&1'
+Error: syntax error, descriptor out of range in '>&99999999999'
+2
+Error: syntax error, descriptor out of range in '1024>'
+d"
+
+# a command that only assigns has the status of its last substitution
+check "status of an assignment" 'x=$(false)
+echo $?
+false
+x=1
+echo $?
+x=$(false) y=`true`
+echo $?
+y=$(true) x=$(sh -c "exit 3")
+echo $?
+x=$(false) > /dev/null
+echo $?' '1
+0
+0
+3
+1'
+
+# every command goes to ~/.j_history as "seconds<tab>status<tab>command",
+# and no redirect can write into the file or replace it
+check "redirects cannot reach the history file" 'false
+echo hi >&3
+/bin/echo hi >&10
+echo hi 12> /dev/null' 'Error: bad file descriptor 3
+Error: bad file descriptor 10
+Error: descriptor 12 is used by the shell'
+check "history log format" 'tail -n 4 $HOME/.j_history | sed "s/^1[0-9]\{9\}/T/"' "T${tab}1${tab}false
+T${tab}1${tab}echo hi >&3
+T${tab}1${tab}/bin/echo hi >&10
+T${tab}1${tab}echo hi 12> /dev/null"
+
+# commands older than histsize are read from the file by number, and
+# the file may be cut short under the shell
+i=1
+while [ $i -le 5000 ]; do
+    printf '1700000000\t0\techo %d\n' $i
+    i=$((i + 1))
+done > "$home/.j_history"
+rm -f "$home/.j_history.idx"
+check "history N M from the file" 'history 10 12
+!20' "10${tab}echo 10
+11${tab}echo 11
+12${tab}echo 12
+echo 20
+20"
+check "history file cut short" 'set histsize=2
+truncate -s 0 $HOME/.j_history
+history 1 3 > /dev/null
+echo $?' '0'
+
+# a command's number is its line in the file, whoever wrote the lines
+# in between, and a repeated command is only added once
+printf 'sleep 0.2\nprintf "1\\t0\\techo injected\\n" >> "$HOME/.j_history"\n' > "$home/inject"
+check "history numbers follow the file" 'sh $HOME/inject
+history | tail -n 3 | cut -f 2
+!-3
+echo a
+echo a
+history 2 | cut -f 2' 'echo injected
+sh $HOME/inject
+history | tail -n 3 | cut -f 2
+echo injected
+injected
+a
+a
+echo a
+history 2 | cut -f 2'
+
+# Ctrl-R finds commands through the index of the file, once the first
+# Ctrl-R (cancelled with Ctrl-G) has started building it
+i=1
+while [ $i -le 5000 ]; do
+    printf '1700000000\t0\techo %d\n' $i
+    i=$((i + 1))
+done > "$home/.j_history"
+rm -f "$home/.j_history.idx"
+check "Ctrl-R through the index" "sh \$HOME/inject
+$(printf '\022\007')
+sleep 0.5
+$(printf '\022')injected
+$(printf '\022')echo 12" 'injected
+1299'
+
+# a child of fork() or vfork() hands its error to the shell, which prints
+# it, and a builtin in a pipeline does not hold up the commands after it
+check "errors of a vfork child" 'set spawn=vfork
+/etc/passwd
+cat < /nonexistent
+/bin/echo a >&7
+set spawn=fork
+set pipesize=4k
+history 1 5000 | wc -l' "Error: cannot run the program '/etc/passwd' - Permission denied
+Error: cannot open input file /nonexistent
+Error: bad file descriptor 7
+5000"
+
+# a program is remembered where it was found in $PATH until $PATH
+# changes, "hash -r" forgets it or it is no longer there
+mkdir "$home/a" "$home/b"
+printf '#!/bin/sh\necho a\n' > "$home/a/prog"
+printf '#!/bin/sh\necho b\n' > "$home/b/prog"
+chmod +x "$home/a/prog" "$home/b/prog"
+check "hash and a PATH change" 'PATH=$HOME/a:/usr/bin:/bin
+prog
+prog
+hash
+PATH=$HOME/b:$HOME/a:/usr/bin:/bin
+prog
+hash -r
+hash
+echo $?
+hash prog
+hash
+rm $HOME/b/prog
+prog' "a
+a
+hits${tab}command
+   2${tab}$home/a/prog
+b
+0
+hits${tab}command
+   0${tab}$home/b/prog
+a"
+
+# aliases, variables and programs share one hash table, entries left
+# after others are removed are still found once it has grown
+aliases=$(i=0; while [ $i -lt 200 ]; do printf 'alias a%d="echo %d"\n' $i $i; i=$((i + 1)); done)
+unaliases=$(i=0; while [ $i -lt 200 ]; do printf 'unalias a%d\n' $i; i=$((i + 2)); done)
+check "table after removals" "$aliases
+$unaliases
+alias | wc -l
+a1
+a199
+alias | cut -f 1 | grep -cx a2" '100
+1
+199
+0'
+
+# a line seen before is not parsed again, its variables are still
+# expanded every time it runs, and a new alias empties the cache
+check "parsed line cache" 'alias ll="echo one"
+x=1
+ll $x
+x=2
+ll $x
+alias lk="echo two"
+ll $x
+cache' "one 1
+one 2
+one 2
+hits${tab}1
+misses${tab}7
+evictions${tab}0
+invalidations${tab}2
+entries${tab}2/64"
+
+# an alias value is split into words when it is defined, and a line
+# cached with the alias is not used once it is removed
+check "alias words and unalias" "alias say='echo \"a  b\" c'
+say d
+say d
+unalias say
+say d
+alias say=\"echo new\"
+say d" "a  b c d
+a  b c d
+Error: cannot run the program 'say'
+       this may be because the program is not in \$PATH or
+       there is not an alias specified for this command, among other possibilities
+new d"
+
+# aliases are spliced into every stage and variables into long lines
+# without words being lost or moved
+words=$(i=0; while [ $i -lt 2000 ]; do printf ' $x'; i=$((i + 1)); done)
+check "alias and variable splicing" "alias e='echo 1 2'
+alias c=cat
+x=ab
+e \$x 3 \$x | c | c
+echo$words | wc -c
+e$words | wc -w" '1 2 ab 3 ab
+6000
+2002'
+
+# programs see exported variables as they are after export, unset or an
+# assignment, and NAME=value in front of a program only changes its own
+check "environment of a program" 'export A=1
+printenv A
+A=2
+printenv A
+B=3
+printenv B || echo unset
+export B
+printenv B
+C=4 printenv C
+printenv C || echo unset
+A=5 printenv A
+printenv A
+unset A
+printenv A || echo unset' '1
+2
+unset
+3
+4
+unset
+5
+2
+unset'
+
+# ${} operators and $(( )) run in the shell, a division by zero is an
+# error and the one overflowing division wraps instead of trapping
+check "parameter expansion" 'x=/usr/local/lib/libfoo.so.1
+echo ${x##*/} ${x#*/} ${x%.*} ${x%%.*} ${#x}
+unset y
+echo ${y:-d} [$y] ${y:=e} [$y]' 'libfoo.so.1 usr/local/lib/libfoo.so.1 /usr/local/lib/libfoo.so /usr/local/lib/libfoo 26
+d [] e [e]'
+check "arithmetic" 'echo $(( 2 + 3 * 4 )) $(( (2 + 3) * 4 )) $(( 1 << 3 )) $(( -7 / 2 ))
+echo $((1/0))
+echo $?
+echo $(( (-9223372036854775807 - 1) / -1 )) $(( (-9223372036854775807 - 1) % -1 ))
+echo $?' '14 20 8 -3
+Error: division by zero - 1/0
+1
+-9223372036854775808 0
+0'
+
+# the writer thread has every command in the file, in order, once the
+# shell exits, even when more were run than the ring holds
+rm -f "$home/.j_history" "$home/.j_history.idx"
+lines=$(i=0; while [ $i -lt 3000 ]; do printf 'echo %d > /dev/null\n' $i; i=$((i + 1)); done)
+check "history written from the ring" "$lines" ''
+check "history written in order" 'wc -l < $HOME/.j_history
+head -n 3000 $HOME/.j_history | cut -f 3 | awk "\$2 != NR - 1" | wc -l' '3000
+0'
+
+rm -rf "$home"
+
+if [ $failures -ne 0 ]; then
+    echo "shell_test: $failures of $cases cases failed"
+    exit 1
+fi
+
+echo "shell_test: $cases cases passed"